@@ -0,0 +1,86 @@
+#include "bench.h"
+
+// ALU helpers with table lookups against the bit-loop parity() versions they
+// replaced. Every helper runs over all 65536 operand pairs per pass.
+
+// The old flag code, kept here only for comparison //
+
+static bool old_parity(uint8_t x) {
+	uint8_t count = 0, i, b = 1;
+
+	for (i = 0; i < 8; i++) {
+		if (x & (b << i)) { count++; }
+	}
+
+	if ((count % 2)) { return false; }
+
+	return true;
+}
+
+static void old_ADD(CPU* const cpu, uint8_t const a, uint8_t const val, bool const cy) {
+	uint16_t answer = (uint16_t)a + (uint16_t)val + cy;
+	cpu->cc.z = ((answer & 0xff) == 0);
+	cpu->cc.s = ((answer & 0x80) != 0);
+	cpu->cc.cy = (answer > 0xff);
+	cpu->cc.p = old_parity(answer & 0xff);
+	cpu->a = answer & 0xff;
+}
+
+static void old_ANA(CPU* const cpu, uint8_t const address) {
+	uint8_t answer = cpu->a & address;
+	cpu->cc.z = ((answer) == 0);
+	cpu->cc.s = (0x80 == (answer & 0x80));
+	cpu->cc.cy = 0;
+	cpu->cc.p = old_parity(answer);
+	cpu->a = answer;
+}
+
+static void old_CMP(CPU* const cpu, uint8_t const address) {
+	int16_t answer = cpu->a - address;
+	cpu->cc.z = ((answer) == 0);
+	cpu->cc.s = (0x80 == (answer & 0x80));
+	cpu->cc.cy = (cpu->a < answer);
+	cpu->cc.p = old_parity(answer);
+}
+
+static void old_DCR(CPU* const cpu, uint8_t &reg) {
+	uint8_t res = reg - 1;
+	cpu->cc.z = (res == 0);
+	cpu->cc.s = (0x80 == (res & 0x80));
+	cpu->cc.p = old_parity(res);
+	reg = res;
+}
+
+template <typename Op>
+static void run(char const* name, Op op) {
+	int const passes = 200;
+	CPU* cpu = CPU_INIT();
+
+	double start = bench_seconds();
+	for (int pass = 0; pass < passes; pass++) {
+		for (int a = 0; a < 256; a++) {
+			for (int val = 0; val < 256; val++) {
+				cpu->a = (uint8_t) a;
+				op(cpu, (uint8_t) val);
+			}
+		}
+		bench_sink(cpu->a ^ cpu->cc.p);
+	}
+	double seconds = bench_seconds() - start;
+
+	fprintf(stderr, "%-12s %8.2f ns/op\n", name, seconds * 1e9 / (passes * 65536.0));
+	bench_free(cpu);
+}
+
+int main(int argc, char* argv[]) {
+	run("old ADD", [](CPU* cpu, uint8_t val) { old_ADD(cpu, cpu->a, val, 0); });
+	run("ADD", [](CPU* cpu, uint8_t val) { ADD(cpu, cpu->a, val, 0); });
+	run("old ANA", [](CPU* cpu, uint8_t val) { old_ANA(cpu, val); });
+	run("ANA", [](CPU* cpu, uint8_t val) { ANA(cpu, val); });
+	run("old CMP", [](CPU* cpu, uint8_t val) { old_CMP(cpu, val); });
+	run("CMP", [](CPU* cpu, uint8_t val) { CMP(cpu, val); });
+	run("old DCR", [](CPU* cpu, uint8_t val) { cpu->b = val; old_DCR(cpu, cpu->b); });
+	run("DCR", [](CPU* cpu, uint8_t val) { cpu->b = val; DCR(cpu, cpu->b); });
+
+	return 0;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../src/CPU.h"
+
+// Shared helpers for the benchmarks in this folder. Each benchmark is its own
+// program, built together with the emulator sources minus main.cpp, e.g.
+//   g++ -O2 bench/trace_bench.cpp src/CPU.cpp src/Disassembler.cpp src/BlockCache.cpp src/Jit.cpp src/Verify.cpp src/Memory.cpp src/Bus.cpp src/Ports.cpp src/Trace.cpp -pthread
+
+inline double bench_seconds() {
+	using namespace std::chrono;
+	return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Loads a program at address 0 of a fresh CPU
+inline CPU* bench_cpu(uint8_t const* program, size_t size) {
+	CPU* cpu = CPU_INIT();
+	if (cpu == NULL) {
+		exit(1);
+	}
+	memset(cpu->memory, 0, 0x10000);
+	memcpy(cpu->memory, program, size);
+	return cpu;
+}
+
+// Stores a result where the compiler can't see it unused, so it keeps the
+// work that produced it
+static volatile uint32_t bench_sink_value;
+
+inline void bench_sink(uint32_t const value) {
+	bench_sink_value = value;
+}
+
+inline void bench_free(CPU* cpu) {
+	CPU_free(cpu);
+}
+
+// Results go to stderr so trace output on stdout can be thrown away
+inline void bench_report(char const* name, double cycles, double seconds) {
+	fprintf(stderr, "%-24s %10.0f cycles %8.3f s %10.2f MHz\n",
+		name, cycles, seconds, cycles / seconds / 1e6);
+}
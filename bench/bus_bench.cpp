@@ -0,0 +1,120 @@
+#include "bench.h"
+#include "../src/BlockCache.h"
+#include "../src/Bus.h"
+#include "../src/Jit.h"
+
+// Loads and stores through the bus page tables against the direct indexing
+// and code page check they replaced, then a copy loop on the interpreter
+// with the flat and the Space Invaders maps. First it checks that every
+// engine sees code patched through a RAM mirror.
+
+// The old access path, kept here only for comparison //
+
+static uint8_t old_read(CPU const* cpu, uint16_t const address) {
+	return cpu->memory[address];
+}
+
+static void old_write(CPU* const cpu, uint16_t const address, uint8_t const val) {
+	cpu->memory[address] = val;
+	if (cpu->code_pages[address >> 13] & (1u << ((address >> 8) & 31))) {
+		CPU_code_written(cpu, address);
+	}
+}
+
+// Each pass reads and writes every address once, in a scattered order
+template <typename Op>
+static void run(char const* name, CPU* cpu, Op op) {
+	int const passes = 2000;
+
+	double start = bench_seconds();
+	uint8_t acc = 0;
+	for (int pass = 0; pass < passes; pass++) {
+		uint16_t address = (uint16_t) pass;
+		for (int i = 0; i < 0x10000; i++) {
+			acc = op(cpu, address, acc);
+			address = (uint16_t) (address * 5 + 1); // full period mod 64K
+		}
+	}
+	bench_sink(acc);
+	double seconds = bench_seconds() - start;
+
+	fprintf(stderr, "%-24s %8.3f ns/access\n", name, seconds * 1e9 / (passes * 65536.0 * 2));
+}
+
+// LXI H,2400; LXI D,3000; MVI B,0
+// loop: LDAX D; MOV M,A; INX D; INX H; DCR B; JNZ loop; JMP 0
+static uint8_t const COPY_LOOP[] = {
+	0x21, 0x00, 0x24, 0x11, 0x00, 0x30, 0x06, 0x00,
+	0x1a, 0x77, 0x13, 0x23, 0x05, 0xc2, 0x08, 0x00, 0xc3, 0x00, 0x00,
+};
+
+static void run_program(char const* name, void (*map)(CPU*)) {
+	CPU* cpu = bench_cpu(COPY_LOOP, sizeof(COPY_LOOP));
+	map(cpu);
+
+	double const cycles = 400e6;
+	double start = bench_seconds();
+	cpu_run<NoTrace>(cpu, cycles);
+	bench_report(name, cycles, bench_seconds() - start);
+	bench_free(cpu);
+}
+
+// Calls a routine at $2100 until the engines have compiled it, patches it
+// through the mirror at $6100, then calls it again:
+// LXI SP,2400; MVI C,0
+// loop: CALL 2100; DCR C; JNZ loop
+// MVI A,2; STA 6101; CALL 2100; done: JMP done
+// The routine is MVI A,1; RET, so A ends up 2 only if the patch was seen.
+static uint8_t const MIRROR_PATCH[] = {
+	0x31, 0x00, 0x24, 0x0e, 0x00,
+	0xcd, 0x00, 0x21, 0x0d, 0xc2, 0x05, 0x00,
+	0x3e, 0x02, 0x32, 0x01, 0x61, 0xcd, 0x00, 0x21, 0xc3, 0x14, 0x00,
+};
+static uint8_t const MIRROR_ROUTINE[] = { 0x3e, 0x01, 0xc9 };
+
+static bool check_mirror(char const* name, int (*run)(CPU*, double), void (*init)(CPU*)) {
+	CPU* cpu = bench_cpu(MIRROR_PATCH, sizeof(MIRROR_PATCH));
+	memcpy(cpu->memory + 0x2100, MIRROR_ROUTINE, sizeof(MIRROR_ROUTINE));
+	bus_map_invaders(cpu);
+	if (init != NULL) {
+		init(cpu);
+	}
+
+	run(cpu, 100000);
+	bool const ok = cpu->a == 2;
+	fprintf(stderr, "%-24s %s\n", name, ok ? "ok" : "stale code after a store through a mirror");
+
+	block_cache_free(cpu);
+	jit_free(cpu);
+	bench_free(cpu);
+	return ok;
+}
+
+int main(int argc, char* argv[]) {
+	bool ok = check_mirror("mirror patch, switch", cpu_run<NoTrace>, NULL);
+	ok &= check_mirror("mirror patch, blocks", cpu_run_blocks<EagerFlags>, block_cache_init);
+	if (jit_available()) {
+		ok &= check_mirror("mirror patch, jit", cpu_run_jit, jit_init);
+	}
+	if (!ok) {
+		return 1;
+	}
+
+	CPU* cpu = CPU_INIT();
+	bus_map_invaders(cpu);
+
+	run("old read+write", cpu, [](CPU* cpu, uint16_t address, uint8_t acc) {
+		old_write(cpu, address ^ 0x2000, acc);
+		return (uint8_t) (acc + old_read(cpu, address));
+	});
+	run("bus read+write", cpu, [](CPU* cpu, uint16_t address, uint8_t acc) {
+		CPU_write(cpu, address ^ 0x2000, acc);
+		return (uint8_t) (acc + CPU_read(cpu, address));
+	});
+	bench_free(cpu);
+
+	run_program("copy loop, flat", bus_map_flat);
+	run_program("copy loop, invaders", bus_map_invaders);
+
+	return 0;
+}
@@ -0,0 +1,369 @@
+#include <cstdlib>
+#include <initializer_list>
+#include <string>
+#include <vector>
+#include "bench.h"
+#include "../src/BlockCache.h"
+#include "../src/Files.h"
+#include "../src/Jit.h"
+#include "../src/Machine.h"
+#include "../src/OpCounts.h"
+#include "../src/Threaded.h"
+
+// The regression suite, in three parts:
+// - micro: one class of instructions (ALU, memory, branch, stack) in a loop,
+//   stepped through EmulateI8080_op one instruction at a time;
+// - kernel: small 8080 programs (a memcpy loop, a BCD counter with DAA, a
+//   chain of calls and returns) on every engine this build has;
+// - rom: a ROM supplied with --rom=FILE, run for --frames=N frames (600 by
+//   default) on every engine, interrupts included.
+// Every result has emulated MHz and ns per instruction, ROM runs frames per
+// second too. --json=FILE also writes them as JSON whose layout only changes
+// along with "schema", so results can be compared between releases.
+// Built with the emulator sources minus main.cpp:
+//   g++ -O2 bench/suite_bench.cpp src/CPU.cpp src/Disassembler.cpp src/BlockCache.cpp src/Jit.cpp src/Verify.cpp src/Memory.cpp src/Bus.cpp src/Ports.cpp src/Trace.cpp src/Threaded.cpp src/Scheduler.cpp src/Machine.cpp src/OpCounts.cpp -pthread
+
+int const SCHEMA = 1;
+
+struct Result {
+	std::string section; // micro, kernel or rom
+	std::string name;
+	std::string engine;
+	double instructions;
+	double cycles;
+	double seconds;
+	uint64_t frames; // rom only
+};
+
+static std::vector<Result> results;
+
+static void report(Result const& result) {
+	fprintf(stderr, "%-7s %-10s %-9s %10.2f MHz %8.2f ns/instruction", result.section.c_str(),
+		result.name.c_str(), result.engine.c_str(), result.cycles / result.seconds / 1e6,
+		result.seconds * 1e9 / result.instructions);
+	if (result.frames > 0) {
+		fprintf(stderr, " %10.1f frames/s", result.frames / result.seconds);
+	}
+	fprintf(stderr, "\n");
+	results.push_back(result);
+}
+
+// Copies bytes to memory at address
+static void put(CPU* cpu, uint16_t const address, std::initializer_list<uint8_t> bytes) {
+	uint16_t at = address;
+	for (uint8_t const byte : bytes) {
+		cpu->memory[at++] = byte;
+	}
+}
+
+// Micro benchmarks //
+
+static void load_alu(CPU* cpu) {
+	put(cpu, 0x0000, {
+		0xc6, 0x01,			// 0000 ADI $01
+		0xe6, 0x7f,			// 0002 ANI $7f
+		0xfe, 0x40,			// 0004 CPI $40
+		0xa7,				// 0006 ANA A
+		0xaf,				// 0007 XRA A
+		0x05,				// 0008 DCR B
+		0x09,				// 0009 DAD B
+		0xc3, 0x00, 0x00,	// 000a JMP $0000
+	});
+}
+
+static void load_memory(CPU* cpu) {
+	put(cpu, 0x0000, {
+		0x21, 0x00, 0x20,	// 0000 LXI H,$2000
+		0x11, 0x00, 0x21,	// 0003 LXI D,$2100
+		0x77,				// 0006 MOV M,A
+		0x7e,				// 0007 MOV A,M
+		0x36, 0x55,			// 0008 MVI M,$55
+		0x32, 0x02, 0x20,	// 000a STA $2002
+		0x3a, 0x02, 0x20,	// 000d LDA $2002
+		0x1a,				// 0010 LDAX D
+		0x5e,				// 0011 MOV E,M
+		0xc3, 0x06, 0x00,	// 0012 JMP $0006
+	});
+}
+
+static void load_branch(CPU* cpu) {
+	put(cpu, 0x0000, {
+		0xaf,				// 0000 XRA A, sets Z and clears CY
+		0xca, 0x05, 0x00,	// 0001 JZ $0005, taken
+		0x00,				// 0004 NOP
+		0xc2, 0x00, 0x00,	// 0005 JNZ $0000, not taken
+		0xda, 0x00, 0x00,	// 0008 JC $0000, not taken
+		0xd2, 0x0f, 0x00,	// 000b JNC $000f, taken
+		0x00,				// 000e NOP
+		0xc3, 0x00, 0x00,	// 000f JMP $0000
+	});
+}
+
+static void load_stack(CPU* cpu) {
+	put(cpu, 0x0000, {
+		0x31, 0x00, 0x24,	// 0000 LXI SP,$2400
+		0xc5,				// 0003 PUSH B
+		0xd5,				// 0004 PUSH D
+		0xe5,				// 0005 PUSH H
+		0xf5,				// 0006 PUSH PSW
+		0xf1,				// 0007 POP PSW
+		0xe1,				// 0008 POP H
+		0xd1,				// 0009 POP D
+		0xc1,				// 000a POP B
+		0xc3, 0x03, 0x00,	// 000b JMP $0003
+	});
+}
+
+static void micro(char const* name, void (*load)(CPU*)) {
+	long const instructions = 20000000;
+	CPU* cpu = CPU_INIT();
+	load(cpu);
+
+	double cycles = 0;
+	double start = bench_seconds();
+	for (long i = 0; i < instructions; i++) {
+		cycles += EmulateI8080_op<NoTrace, EagerFlags>(cpu);
+	}
+	double seconds = bench_seconds() - start;
+
+	report({ "micro", name, "switch", (double) instructions, cycles, seconds, 0 });
+	bench_free(cpu);
+}
+
+// Kernels //
+
+// Copies 256 bytes from $1000 to $2000, over and over
+static void load_memcpy(CPU* cpu) {
+	put(cpu, 0x0000, {
+		0x11, 0x00, 0x10,	// 0000 LXI D,$1000
+		0x21, 0x00, 0x20,	// 0003 LXI H,$2000
+		0x06, 0x00,			// 0006 MVI B,$00, 256 passes
+		0x1a,				// 0008 LDAX D
+		0x77,				// 0009 MOV M,A
+		0x13,				// 000a INX D
+		0x23,				// 000b INX H
+		0x05,				// 000c DCR B
+		0xc2, 0x08, 0x00,	// 000d JNZ $0008
+		0xc3, 0x00, 0x00,	// 0010 JMP $0000
+	});
+}
+
+// Counts 00 to 99 in BCD into $2000, over and over
+static void load_bcd(CPU* cpu) {
+	put(cpu, 0x0000, {
+		0x3e, 0x00,			// 0000 MVI A,$00
+		0x06, 0x64,			// 0002 MVI B,100
+		0xc6, 0x01,			// 0004 ADI $01
+		0x27,				// 0006 DAA
+		0x32, 0x00, 0x20,	// 0007 STA $2000
+		0x05,				// 000a DCR B
+		0xc2, 0x04, 0x00,	// 000b JNZ $0004
+		0xc3, 0x00, 0x00,	// 000e JMP $0000
+	});
+}
+
+// Four calls deep and back, over and over
+static void load_calls(CPU* cpu) {
+	put(cpu, 0x0000, {
+		0x31, 0x00, 0x24,	// 0000 LXI SP,$2400
+		0xcd, 0x10, 0x00,	// 0003 CALL $0010
+		0xc3, 0x03, 0x00,	// 0006 JMP $0003
+	});
+	put(cpu, 0x0010, {
+		0xc5,				// 0010 PUSH B
+		0xcd, 0x20, 0x00,	// 0011 CALL $0020
+		0xc1,				// 0014 POP B
+		0xc9,				// 0015 RET
+	});
+	put(cpu, 0x0020, { 0xcd, 0x30, 0x00, 0xc9 });	// 0020 CALL $0030, RET
+	put(cpu, 0x0030, { 0xcd, 0x40, 0x00, 0xc9 });	// 0030 CALL $0040, RET
+	put(cpu, 0x0040, { 0xc9 });						// 0040 RET
+}
+
+struct Engine {
+	char const* name;
+	int (*run)(CPU*, double);
+	void (*init)(CPU*); // NULL if the engine needs none
+	bool available;
+};
+
+static std::vector<Engine> engines() {
+	std::vector<Engine> all;
+	all.push_back({ "switch", cpu_run<NoTrace, EagerFlags>, NULL, true });
+	all.push_back({ "threaded", cpu_run_threaded<EagerFlags>, NULL, threaded_available() });
+	all.push_back({ "blocks", cpu_run_blocks<EagerFlags>, block_cache_init, true });
+	all.push_back({ "jit", cpu_run_jit, jit_init, jit_available() });
+	return all;
+}
+
+static void engine_free(CPU* cpu) {
+	block_cache_free(cpu);
+	jit_free(cpu);
+}
+
+// Instructions per cycle of a program, counted with the switch core. Every
+// engine runs the same instructions, so this turns any engine's cycles into
+// instructions.
+static double instructions_per_cycle(void (*load)(CPU*), double cycles) {
+	CPU* cpu = CPU_INIT();
+	load(cpu);
+	OpCounts counts;
+	op_counts_clear(&counts);
+	cpu->counts = &counts;
+	int const ran = cpu_run<CountTrace, EagerFlags>(cpu, cycles);
+	bench_free(cpu);
+	return (double) op_counts_total(&counts) / ran;
+}
+
+static void kernel(char const* name, void (*load)(CPU*)) {
+	double const cycles = 200 * CYCLES_PER_TIC;
+	double const per_cycle = instructions_per_cycle(load, cycles);
+
+	for (Engine const& engine : engines()) {
+		if (!engine.available) {
+			continue;
+		}
+
+		CPU* cpu = CPU_INIT();
+		load(cpu);
+		if (engine.init != NULL) {
+			engine.init(cpu);
+		}
+
+		double start = bench_seconds();
+		double const ran = engine.run(cpu, cycles);
+		double seconds = bench_seconds() - start;
+
+		report({ "kernel", name, engine.name, ran * per_cycle, ran, seconds, 0 });
+		engine_free(cpu);
+		bench_free(cpu);
+	}
+}
+
+// Whole ROM //
+
+static bool rom_runs(char const* path, int const frames) {
+	// Instructions per cycle, counted with the switch core
+	Machine* counting = machine_init();
+	if (!machine_load(counting, path)) {
+		machine_free(counting);
+		return false;
+	}
+	OpCounts counts;
+	op_counts_clear(&counts);
+	counting->cpu->counts = &counts;
+	counting->run = cpu_run<CountTrace, EagerFlags>;
+	for (int frame = 0; frame < frames; frame++) {
+		machine_run_frame(counting);
+	}
+	double const per_cycle = (double) op_counts_total(&counts) / counting->scheduler.now;
+	machine_free(counting);
+
+	for (Engine const& engine : engines()) {
+		if (!engine.available) {
+			continue;
+		}
+
+		Machine* machine = machine_init();
+		machine->run = engine.run;
+		if (engine.init != NULL) {
+			engine.init(machine->cpu);
+		}
+		machine_load(machine, path);
+
+		double start = bench_seconds();
+		for (int frame = 0; frame < frames; frame++) {
+			machine_run_frame(machine);
+		}
+		double seconds = bench_seconds() - start;
+
+		double const ran = (double) machine->scheduler.now;
+		report({ "rom", "rom", engine.name, ran * per_cycle, ran, seconds, (uint64_t) frames });
+		machine_free(machine);
+	}
+	return true;
+}
+
+// JSON //
+
+static void write_string(FILE* f, char const* s) {
+	fputc('"', f);
+	for (; *s != '\0'; s++) {
+		if (*s == '"' || *s == '\\') {
+			fputc('\\', f);
+		}
+		fputc(*s, f);
+	}
+	fputc('"', f);
+}
+
+static bool write_json(char const* path, char const* rom, int const frames) {
+	FILE* f = file_open(path, "w");
+	if (f == NULL) {
+		fprintf(stderr, "error: Couldn't create %s\n", path);
+		return false;
+	}
+
+	fprintf(f, "{\n\t\"schema\": %d,\n\t\"rom\": ", SCHEMA);
+	if (rom != NULL) {
+		write_string(f, rom);
+	}
+	else {
+		fprintf(f, "null");
+	}
+	fprintf(f, ",\n\t\"frames\": %d,\n\t\"results\": [", frames);
+
+	char const* separator = "\n";
+	for (Result const& result : results) {
+		fprintf(f, "%s\t\t{ \"section\": \"%s\", \"name\": \"%s\", \"engine\": \"%s\", ", separator,
+			result.section.c_str(), result.name.c_str(), result.engine.c_str());
+		fprintf(f, "\"instructions\": %.0f, \"cycles\": %.0f, \"seconds\": %.6f, \"mhz\": %.3f, \"ns_per_instruction\": %.3f",
+			result.instructions, result.cycles, result.seconds, result.cycles / result.seconds / 1e6,
+			result.seconds * 1e9 / result.instructions);
+		if (result.frames > 0) {
+			fprintf(f, ", \"frames_per_second\": %.3f", result.frames / result.seconds);
+		}
+		fprintf(f, " }");
+		separator = ",\n";
+	}
+	fprintf(f, "\n\t]\n}\n");
+
+	bool ok = ferror(f) == 0;
+	fclose(f);
+	return ok;
+}
+
+int main(int argc, char* argv[]) {
+	char const* rom = NULL;
+	int frames = 600;
+	char const* json = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--rom=", 6) == 0) {
+			rom = argv[i] + 6;
+		}
+		else if (strncmp(argv[i], "--frames=", 9) == 0) {
+			frames = atoi(argv[i] + 9);
+		}
+		else if (strncmp(argv[i], "--json=", 7) == 0) {
+			json = argv[i] + 7;
+		}
+	}
+
+	micro("alu", load_alu);
+	micro("memory", load_memory);
+	micro("branch", load_branch);
+	micro("stack", load_stack);
+
+	kernel("memcpy", load_memcpy);
+	kernel("bcd", load_bcd);
+	kernel("calls", load_calls);
+
+	if (rom != NULL && !rom_runs(rom, frames)) {
+		return 1;
+	}
+
+	if (json != NULL && !write_json(json, rom, frames)) {
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,45 @@
+#include "bench.h"
+#include "../src/Trace.h"
+
+// Emulated MHz of the interpreter with and without tracing compiled in.
+// Run with stdout redirected (> /dev/null or > NUL) to time the trace
+// formatting instead of the terminal. RingTrace writes bench.trace in the
+// working directory.
+
+// A small loop built only from implemented instructions
+static uint8_t const PROGRAM[] = {
+	0x31, 0x00, 0x24,	// 0000 LXI SP,$2400
+	0x06, 0xff,			// 0003 MVI B,$ff
+	0x3e, 0x00,			// 0005 MVI A,$00
+	0xc6, 0x01,			// 0007 ADI $01
+	0x05,				// 0009 DCR B
+	0xc2, 0x07, 0x00,	// 000a JNZ $0007
+	0xc3, 0x03, 0x00,	// 000d JMP $0003
+};
+
+// trace_path is where RingTrace writes to, NULL for the other policies
+template <typename Trace>
+static void run(char const* name, double cycles, char const* trace_path = NULL) {
+	CPU* cpu = bench_cpu(PROGRAM, sizeof(PROGRAM));
+	if (trace_path != NULL && !trace_open(cpu, trace_path)) {
+		bench_free(cpu);
+		return;
+	}
+
+	double start = bench_seconds();
+	cpu_run<Trace>(cpu, cycles);
+	trace_close(cpu);  // the writer has to catch up too
+	bench_report(name, cycles, bench_seconds() - start);
+
+	bench_free(cpu);
+}
+
+int main(int argc, char* argv[]) {
+	double const cycles = 100 * CYCLES_PER_TIC;  // 100 frames worth
+
+	run<NoTrace>("NoTrace", cycles);
+	run<PrintTrace>("PrintTrace", cycles / 10);
+	run<RingTrace>("RingTrace", cycles, "bench.trace");
+
+	return 0;
+}
@@ -0,0 +1,73 @@
+#include <cstdlib>
+#include "bench.h"
+#include "../src/Video.h"
+
+// Whole frames of VRAM turned into 32 bit pixels: the bit at a time loop
+// draw_video_ram used to run, the lookup table kernel, and the kernel this
+// build picked (see I8080_VIDEO_AVX2). Built with src/Video.cpp as well.
+
+// The old conversion, kept here only for comparison. It starts one row low,
+// so the buffer has a spare row.
+static void old_expand(uint8_t const* vram, uint32_t* pix) {
+	int i = 0;
+	for (int col = 0; col < SCREEN_WIDTH; col++) {
+		for (int row = SCREEN_HEIGHT; row > 0; row -= 8) {
+			for (int j = 0; j < 8; j++) {
+				int idx = (row - j) * SCREEN_WIDTH + col;
+
+				if (vram[i] & 1 << j) {
+					pix[idx] = 0xFFFFFF;
+				}
+				else {
+					pix[idx] = 0x000000;
+				}
+			}
+
+			i++;
+		}
+	}
+}
+
+template <typename Op>
+static void run(char const* name, uint32_t* pixels, Op op) {
+	int const frames = 20000;
+
+	double start = bench_seconds();
+	for (int frame = 0; frame < frames; frame++) {
+		op(frame);
+		bench_sink(pixels[frame & 0xffff]);
+	}
+	double seconds = bench_seconds() - start;
+
+	fprintf(stderr, "%-24s %8d frames %8.3f s %10.0f frames/s %8.2f us/frame\n",
+		name, frames, seconds, frames / seconds, seconds / frames * 1e6);
+}
+
+int main() {
+	// Mostly dark like the game, with some sprites
+	static uint8_t vram[VRAM_SIZE];
+	srand(1);
+	for (int i = 0; i < VRAM_SIZE; i++) {
+		vram[i] = rand() % 4 == 0 ? (uint8_t) rand() : 0;
+	}
+
+	static uint32_t pixels[(SCREEN_HEIGHT + 1) * SCREEN_WIDTH];
+	static VideoPalette mono;
+	static VideoPalette overlay;
+	video_palette_mono(&mono, 0xffffff);
+	video_palette_overlay(&overlay);
+
+	run("bit loop", pixels, [&](int) {
+		old_expand(vram, pixels);
+	});
+	run("lookup table", pixels, [&](int) {
+		video_expand_scalar(vram, pixels, SCREEN_WIDTH, &mono, 0, SCREEN_WIDTH);
+	});
+	run(video_expand_kernel(), pixels, [&](int) {
+		video_expand(vram, pixels, SCREEN_WIDTH, &mono, 0, SCREEN_WIDTH);
+	});
+	run("overlay", pixels, [&](int) {
+		video_expand(vram, pixels, SCREEN_WIDTH, &overlay, 0, SCREEN_WIDTH);
+	});
+	return 0;
+}
@@ -0,0 +1,71 @@
+#include <cstring>
+#include "Aot.h"
+#include "Flags.h"
+
+#ifdef I8080_AOT
+
+// Compiled blocks by start address, shared by every CPU
+static AotBlock const* by_pc[0x10000];
+
+bool aot_available() {
+	return true;
+}
+
+bool aot_init(CPU* cpu) {
+	for (int address = 0; address < aot_rom_size; address++) {
+		if (CPU_read(cpu, address) != aot_rom[address]) {
+			return false;
+		}
+	}
+
+	// Filled once, machines on other threads may already be running
+	static bool const filled = [] {
+		for (int i = 0; i < aot_block_count; i++) {
+			by_pc[aot_blocks[i].start] = &aot_blocks[i];
+		}
+		return true;
+	}();
+	(void) filled;
+
+	for (int page = 0; page <= (aot_rom_size - 1) >> 8; page++) {
+		CPU_set_code_page(cpu, page, true);
+	}
+
+	return true;
+}
+
+int cpu_run_aot(CPU* cpu, double cycles) {
+	int i = 0;
+	while (i < cycles) {
+		AotBlock const* block = by_pc[cpu->pc];
+
+		// The interpreter starts an instruction whenever fewer than cycles
+		// have run, so the whole block runs if its last one would start
+		if (block != NULL && block->lead_cycles < cycles - i &&
+			aot_live(cpu, block->first_page) && aot_live(cpu, block->last_page)) {
+			i += block->code(cpu);
+		}
+		else {
+			i += EmulateI8080_op<NoTrace, EagerFlags>(cpu);
+		}
+	}
+	return i;
+}
+
+#else
+
+// No generated file in this build, everything runs in the interpreter
+
+bool aot_available() {
+	return false;
+}
+
+bool aot_init(CPU* cpu) {
+	return false;
+}
+
+int cpu_run_aot(CPU* cpu, double cycles) {
+	return cpu_run<NoTrace, EagerFlags>(cpu, cycles);
+}
+
+#endif
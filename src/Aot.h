@@ -0,0 +1,55 @@
+#pragma once
+#include "CPU.h"
+
+// Ahead-of-time compiled ROM code. tools/recompile.cpp walks the code reachable
+// from the reset and interrupt vectors of a ROM image and writes a C++ file
+// with one function per basic block. Building that file in with I8080_AOT
+// defined lets cpu_run_aot run those functions instead of interpreting, with
+// no executable memory needed at run time. Everything the walk didn't reach,
+// I/O and pages that get written run on the EmulateI8080_op interpreter.
+
+typedef int (*AotCode)(CPU* const cpu);
+
+struct AotBlock {
+	uint16_t start;
+	uint8_t first_page;
+	uint8_t last_page; // a block spans at most two pages
+	int lead_cycles; // cycles of every instruction but the last, which may run fewer
+	AotCode code; // returns the cycles it ran
+};
+
+// Defined by the generated file
+extern AotBlock const aot_blocks[];
+extern int const aot_block_count;
+extern uint8_t const aot_rom[];
+extern int const aot_rom_size;
+
+// Whether the compiled code of page still matches memory. Stores into a page
+// with compiled code clear its bit, see CPU_write.
+inline bool aot_live(CPU const* cpu, int const page) {
+	return CPU_has_code(cpu, page);
+}
+
+/*
+	EFFECTS : returns true when this build has a compiled ROM in it
+*/
+
+bool aot_available();
+
+/*
+	REQUIRES: the ROM is loaded into cpu->memory
+	Modifies: cpu->code_pages
+	EFFECTS : Marks the compiled pages live and returns true, or returns
+			  false when memory doesn't hold the ROM the code was
+			  generated from
+*/
+
+bool aot_init(CPU* cpu);
+
+/*
+	REQUIRES: aot_init(cpu) returned true
+	EFFECTS : Same as cpu_run<NoTrace>, running compiled blocks where
+			  there are any
+*/
+
+int cpu_run_aot(CPU* cpu, double cycles);
@@ -0,0 +1,209 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "Batch.h"
+#include "Files.h"
+#include "Headless.h"
+#include "Machine.h"
+
+bool batch_load(std::vector<BatchJob>* jobs, char const* path) {
+	jobs->clear();
+
+	FILE* f = file_open(path, "r");
+	if (f == NULL) {
+		printf("error: Couldn't open %s\n", path);
+		return false;
+	}
+
+	char line[1024];
+	int number = 0;
+	bool ok = true;
+	while (fgets(line, sizeof(line), f) != NULL) {
+		number++;
+		char* p = line;
+		while (*p == ' ' || *p == '\t') {
+			p++;
+		}
+		if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0') {
+			continue;
+		}
+
+		char* end;
+		long frames = strtol(p, &end, 0);
+		if (end == p || frames <= 0) {
+			printf("error: %s:%d: expected \"frames [input-script]\"\n", path, number);
+			ok = false;
+			break;
+		}
+
+		// The rest of the line, trimmed, names the script
+		p = end;
+		while (*p == ' ' || *p == '\t') {
+			p++;
+		}
+		end = p + strlen(p);
+		while (end > p && (end[-1] == '\n' || end[-1] == '\r' || end[-1] == ' ' || end[-1] == '\t')) {
+			end--;
+		}
+
+		BatchJob job;
+		job.frames = (int) frames;
+		job.input.assign(p, end);
+		jobs->push_back(job);
+	}
+	fclose(f);
+
+	return ok;
+}
+
+bool batch_read_rom(std::vector<uint8_t>* rom, char const* path) {
+	FILE* f = file_open(path, "rb");
+	if (f == NULL) {
+		printf("error: Couldn't open %s\n", path);
+		return false;
+	}
+
+	rom->resize(0x10000);
+	rom->resize(fread(rom->data(), 1, rom->size(), f));
+	fclose(f);
+	return true;
+}
+
+static uint32_t fnv1a(uint8_t const* data, size_t const size) {
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ data[i]) * 16777619u;
+	}
+	return hash;
+}
+
+// One worker's jobs. The owner takes from the back, thieves from the front,
+// so the two only meet on the last job. The lock is taken once per job.
+struct WorkQueue {
+	std::mutex lock;
+	std::deque<size_t> jobs;
+};
+
+static bool take_job(std::vector<WorkQueue>& queues, int const self, size_t* job) {
+	int const count = (int) queues.size();
+	for (int k = 0; k < count; k++) {
+		WorkQueue& queue = queues[(self + k) % count];
+		std::lock_guard<std::mutex> guard(queue.lock);
+		if (!queue.jobs.empty()) {
+			if (k == 0) {
+				*job = queue.jobs.back();
+				queue.jobs.pop_back();
+			}
+			else {
+				*job = queue.jobs.front();
+				queue.jobs.pop_front();
+			}
+			return true;
+		}
+	}
+
+	// Nothing is ever queued once the run starts, so every queue stays empty
+	return false;
+}
+
+static BatchResult run_job(BatchJob const& job, std::vector<uint8_t> const& rom, SharedRom const* shared,
+	BatchEngine const& engine) {
+	BatchResult result;
+	result.frames = 0;
+	result.cycles = 0;
+	result.vram_hash = 0;
+	result.ok = true;
+
+	InputScript script;
+	if (!job.input.empty() && !input_script_load(&script, job.input.c_str())) {
+		result.ok = false;
+		return result;
+	}
+
+	Machine* machine = machine_init();
+	if (machine == NULL) {
+		result.ok = false;
+		return result;
+	}
+	machine->run = engine.run;
+	if (engine.map != NULL) {
+		engine.map(machine->cpu);
+	}
+	machine_load_shared(machine, shared, rom.data(), rom.size());
+	if (engine.init != NULL) {
+		engine.init(machine->cpu);
+	}
+	if (!job.input.empty()) {
+		input_script_attach(&script, machine);
+	}
+
+	for (int frame = 0; frame < job.frames; frame++) {
+		machine_run_frame(machine);
+	}
+
+	result.frames = machine->scheduler.frame;
+	result.cycles = machine->scheduler.now;
+	result.vram_hash = fnv1a(machine->cpu->memory + VRAM_START, VRAM_SIZE);
+	machine_free(machine);
+	return result;
+}
+
+double batch_run(std::vector<BatchJob> const& jobs, std::vector<uint8_t> const& rom, BatchEngine engine,
+	int threads, std::vector<BatchResult>* results) {
+	results->assign(jobs.size(), BatchResult());
+
+	// Jobs dealt out in turn, so long and short sessions listed together
+	// start out spread over the workers
+	std::vector<WorkQueue> queues(threads);
+	for (size_t job = 0; job < jobs.size(); job++) {
+		queues[job % threads].jobs.push_back(job);
+	}
+
+	// Every machine maps the same ROM pages
+	SharedRom* shared = shared_rom_create(rom.data(), rom.size());
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> workers;
+	for (int self = 0; self < threads; self++) {
+		workers.emplace_back([&, self] {
+			size_t job;
+			while (take_job(queues, self, &job)) {
+				(*results)[job] = run_job(jobs[job], rom, shared, engine);
+			}
+		});
+	}
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+	shared_rom_free(shared);
+
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+size_t batch_report(std::vector<BatchJob> const& jobs, std::vector<BatchResult> const& results, double seconds, int threads) {
+	uint64_t frames = 0;
+	uint64_t cycles = 0;
+	size_t failed = 0;
+	for (size_t i = 0; i < jobs.size(); i++) {
+		BatchResult const& result = results[i];
+		if (!result.ok) {
+			printf("%zu %s failed\n", i, jobs[i].input.c_str());
+			failed++;
+			continue;
+		}
+
+		printf("%zu %s %llu frames vram %08x\n", i, jobs[i].input.empty() ? "-" : jobs[i].input.c_str(),
+			(unsigned long long) result.frames, result.vram_hash);
+		frames += result.frames;
+		cycles += result.cycles;
+	}
+
+	printf("%zu jobs (%zu failed) on %d threads in %.3f s: %.1f frames/s, %.1f MHz\n", jobs.size(), failed, threads,
+		seconds, seconds > 0 ? frames / seconds : 0.0, seconds > 0 ? cycles / seconds / 1e6 : 0.0);
+	return failed;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "CPU.h"
+
+// Runs many independent machines on every core, for replaying recorded
+// sessions against a ROM. Each worker owns a queue of jobs and steals from
+// the others when it runs dry; a job runs start to end on one thread and
+// writes only its own result, so frames run without any locking. The ROM is
+// mapped once into every machine, see Memory.h.
+
+struct BatchJob {
+	std::string input; // input script of the session, empty for none
+	int frames;
+};
+
+struct BatchResult {
+	uint64_t frames;
+	uint64_t cycles;
+	uint32_t vram_hash; // FNV-1a of the video RAM after the last frame
+	bool ok; // false when the input script couldn't be loaded
+};
+
+// How each machine runs
+struct BatchEngine {
+	int (*run)(CPU*, double);
+	void (*init)(CPU*); // sets up the engine's caches on a new CPU, may be NULL
+	void (*map)(CPU*); // memory map, NULL for the board's
+};
+
+/*
+	Modifies: *jobs
+	EFFECTS : reads the job list at path, one "frames [input-script]" job
+			  per line, # starts a comment. Returns false after printing the
+			  bad line when a line doesn't parse.
+*/
+
+bool batch_load(std::vector<BatchJob>* jobs, char const* path);
+
+/*
+	Modifies: *rom
+	EFFECTS : reads up to 64K of the file at path, returns false if it
+			  can't be read
+*/
+
+bool batch_read_rom(std::vector<uint8_t>* rom, char const* path);
+
+/*
+	REQUIRES: rom.size() <= 0x10000, threads > 0
+	Modifies: *results
+	EFFECTS : runs every job on its own machine loaded with rom, spread over
+			  threads workers. (*results)[i] is the result of jobs[i].
+			  Returns the wall-clock seconds taken.
+*/
+
+double batch_run(std::vector<BatchJob> const& jobs, std::vector<uint8_t> const& rom, BatchEngine engine,
+	int threads, std::vector<BatchResult>* results);
+
+/*
+	EFFECTS : prints one line per job and the totals: jobs, frames per
+			  second and emulated MHz over all cores. Returns the number of
+			  jobs that failed.
+*/
+
+size_t batch_report(std::vector<BatchJob> const& jobs, std::vector<BatchResult> const& results, double seconds, int threads);
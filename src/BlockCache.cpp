@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <cstring>
+#include "BlockCache.h"
+#include "Flags.h"
+
+int const MAX_BLOCK_OPS = 32;
+
+// Instructions the block engine runs itself. Everything else, including the
+// unimplemented ones, ends the block and is left to EmulateI8080_op.
+static bool decodable(uint8_t const op) {
+	switch (op)
+	{
+	case 0x00: case 0x01: case 0x05: case 0x06: case 0x09: case 0x0d: case 0x0e: case 0x0f:
+	case 0x11: case 0x13: case 0x19: case 0x1a:
+	case 0x21: case 0x23: case 0x26: case 0x27: case 0x29:
+	case 0x31: case 0x32: case 0x35: case 0x36: case 0x3a: case 0x3d: case 0x3e:
+	case 0x56: case 0x5e: case 0x66: case 0x6f:
+	case 0x77: case 0x7a: case 0x7b: case 0x7c: case 0x7d: case 0x7e:
+	case 0xa7: case 0xaf:
+	case 0xc0: case 0xc1: case 0xc2: case 0xc3: case 0xc5: case 0xc6: case 0xc8: case 0xc9: case 0xca: case 0xcd:
+	case 0xd1: case 0xd2: case 0xd3: case 0xd5: case 0xda: case 0xdb:
+	case 0xe1: case 0xe5: case 0xe6: case 0xeb:
+	case 0xf1: case 0xf5: case 0xfb: case 0xfe:
+		return true;
+	}
+
+	return false;
+}
+
+// Jumps, calls and returns end a block
+static bool ends_block(uint8_t const op) {
+	switch (op)
+	{
+	case 0xc0: case 0xc2: case 0xc3: case 0xc8: case 0xc9: case 0xca: case 0xcd:
+	case 0xd2: case 0xda:
+		return true;
+	}
+
+	return false;
+}
+
+void block_cache_init(CPU* cpu) {
+	BlockCache* cache = new BlockCache();
+	memset(cache->by_pc, 0, sizeof(cache->by_pc));
+	memset(cache->cold, 0, sizeof(cache->cold));
+	cache->compiled = 0;
+	cache->invalidated = 0;
+	cpu->blocks = cache;
+}
+
+static void free_retired(BlockCache* cache) {
+	for (Block* block : cache->retired) {
+		delete block;
+	}
+	cache->retired.clear();
+}
+
+void block_cache_free(CPU* cpu) {
+	BlockCache* cache = cpu->blocks;
+	if (cache == NULL) {
+		return;
+	}
+
+	for (int page = 0; page < 256; page++) {
+		block_cache_invalidate(cpu, page);
+		delete[] cache->by_pc[page];
+	}
+	free_retired(cache);
+
+	delete cache;
+	cpu->blocks = NULL;
+}
+
+void block_cache_invalidate(CPU* cpu, uint8_t const page) {
+	BlockCache* cache = cpu->blocks;
+	if (cache == NULL) {
+		return;
+	}
+
+	for (Block* block : cache->on_page[page]) {
+		block->valid = false;
+		cache->by_pc[block->start >> 8][block->start & 0xff] = NULL;
+
+		// A block can spill onto the next page, it has to leave that list too
+		for (int other = block->start >> 8; other <= (block->end - 1) >> 8; other++) {
+			if (other != page) {
+				std::vector<Block*>& list = cache->on_page[other];
+				list.erase(std::remove(list.begin(), list.end(), block), list.end());
+			}
+		}
+
+		cache->retired.push_back(block);
+		cache->invalidated++;
+	}
+
+	cache->on_page[page].clear();
+	CPU_set_code_page(cpu, page, false);
+}
+
+// Whether pc was found not to start a block. The mark stays even if the
+// code there is rewritten; that address then just keeps being interpreted.
+static bool is_cold(BlockCache const* cache, uint16_t const pc) {
+	return (cache->cold[pc >> 5] >> (pc & 31)) & 1;
+}
+
+/*
+	EFFECTS : decodes the block starting at pc, returns NULL and marks pc
+			  cold when the first instruction there is not one the block
+			  engine runs
+*/
+
+static Block* compile(CPU* cpu, uint16_t const pc) {
+	BlockCache* cache = cpu->blocks;
+	uint8_t const first = CPU_read(cpu, pc);
+	if (!decodable(first) || pc + lengths8080[first] > 0x10000) {
+		cache->cold[pc >> 5] |= 1u << (pc & 31);
+		return NULL;
+	}
+
+	Block* block = new Block();
+	block->start = pc;
+	block->valid = true;
+
+	int address = pc;
+	while ((int) block->ops.size() < MAX_BLOCK_OPS) {
+		uint8_t op = CPU_read(cpu, address);
+		int length = lengths8080[op];
+		if (!decodable(op) || address + length > 0x10000) {
+			break;
+		}
+
+		DecodedOp decoded;
+		decoded.opcode = op;
+		decoded.cycles = cycles8080[op];
+		decoded.imm = 0;
+		if (length == 2) {
+			decoded.imm = CPU_read(cpu, address + 1);
+		}
+		else if (length == 3) {
+			decoded.imm = (CPU_read(cpu, address + 2) << 8) | CPU_read(cpu, address + 1);
+		}
+		block->ops.push_back(decoded);
+
+		address += length;
+		if (ends_block(op)) {
+			break;
+		}
+	}
+	block->end = address;
+
+	for (int page = pc >> 8; page <= (block->end - 1) >> 8; page++) {
+		cache->on_page[page].push_back(block);
+		CPU_set_code_page(cpu, page, true);
+	}
+
+	Block**& table = cache->by_pc[pc >> 8];
+	if (table == NULL) {
+		table = new Block*[256]();
+	}
+	table[pc & 0xff] = block;
+
+	cache->compiled++;
+	return block;
+}
+
+/*
+	EFFECTS : Runs the ops of block like EmulateI8080_op would, stopping once
+			  i reaches cycles or a store invalidates the block. Returns i.
+*/
+
+template <typename Flags>
+static int run_block(CPU* cpu, Block* block, int i, double const cycles) {
+	for (DecodedOp const& op : block->ops) {
+		uint16_t const imm = op.imm;
+		uint8_t const lo = imm & 0xff;
+		int cycles_taken = op.cycles;
+
+		cpu->pc += 1;
+
+		switch (op.opcode)
+		{
+		case 0x00: NOP(cpu); break; // NOP
+		case 0x01: cpu->c = lo; cpu->b = imm >> 8; cpu->pc += 2; break; // LXI B,D16
+		case 0x05: DCR<Flags>(cpu, cpu->b); break; // DCR B
+		case 0x06: MOV(cpu->b, lo); cpu->pc++; break; // MVI B, D8
+		case 0x09: DAD(cpu, CPU_get_bc(cpu)); break; // DAD B
+		case 0x0d: DCR<Flags>(cpu, cpu->c); break; // DCR C
+		case 0x0e: MOV(cpu->c, lo); cpu->pc++; break; // MVI C, D8
+		case 0x0f: RRC(cpu); break; // RRC
+		case 0x11: cpu->e = lo; cpu->d = imm >> 8; cpu->pc += 2; break; // LXI D, word
+		case 0x13: CPU_set_de(cpu, CPU_get_de(cpu) + 1); break; // INX D
+		case 0x19: DAD(cpu, CPU_get_de(cpu)); break; // DAD D
+		case 0x1a: MOV(cpu->a, CPU_read(cpu, CPU_get_de(cpu))); break; // LDAX D
+		case 0x21: cpu->l = lo; cpu->h = imm >> 8; cpu->pc += 2; break; // LXI H, D16
+		case 0x23: CPU_set_hl(cpu, CPU_get_hl(cpu) + 1); break; // INX H
+		case 0x26: MOV(cpu->h, lo); cpu->pc++; break; // MVI H, D8
+		case 0x27: DAA<Flags>(cpu); break; // DAA
+		case 0x29: DAD(cpu, CPU_get_hl(cpu)); break; // DAD H
+		case 0x31: cpu->sp = imm; cpu->pc += 2; break; // LXI SP,word
+		case 0x32: CPU_write(cpu, imm, cpu->a); cpu->pc += 2; break; // STA adr
+		case 0x35: CPU_set_hl(cpu, CPU_get_hl(cpu) - 1); break; // DCR M
+		case 0x36: CPU_write(cpu, CPU_get_hl(cpu), lo); cpu->pc++; break; // MVI M, D8
+		case 0x3a: MOV(cpu->a, CPU_read(cpu, imm)); cpu->pc += 2; break; // LDA adr
+		case 0x3d: DCR<Flags>(cpu, cpu->a); break; // DCR A
+		case 0x3e: MOV(cpu->a, lo); cpu->pc++; break; // MVI A, D8
+		case 0x56: MOV(cpu->d, CPU_read(cpu, CPU_get_hl(cpu))); break; // MOV D, M
+		case 0x5e: MOV(cpu->e, CPU_read(cpu, CPU_get_hl(cpu))); break; // MOV E, M
+		case 0x66: MOV(cpu->h, CPU_read(cpu, CPU_get_hl(cpu))); break; // MOV H, M
+		case 0x6f: MOV(cpu->l, cpu->a); break; // MOV L, A
+		case 0x77: CPU_write(cpu, CPU_get_hl(cpu), cpu->a); break; // MOV M, A
+		case 0x7a: MOV(cpu->a, cpu->d); break; // MOV A, D
+		case 0x7b: MOV(cpu->a, cpu->e); break; // MOV A, E
+		case 0x7c: MOV(cpu->a, cpu->h); break; // MOV A, H
+		case 0x7d: MOV(cpu->a, cpu->l); break; // MOV A, L
+		case 0x7e: MOV(cpu->a, CPU_read(cpu, CPU_get_hl(cpu))); break; // MOV A, M
+		case 0xa7: ANA<Flags>(cpu, cpu->a); break; // ANA A
+		case 0xaf: XRA<Flags>(cpu, cpu->a); break; // XRA A
+		case 0xc0: Flags::sync(cpu); // RNZ
+			if (!RET_COND(cpu, cpu->cc.z != 0)) cycles_taken = CYCLES_RET_SKIPPED;
+			break;
+		case 0xc1: POP(cpu, "B"); break; // POP B
+		case 0xc2: Flags::sync(cpu); JMP_COND(cpu, imm, 0 == cpu->cc.z); break; // JNZ adr
+		case 0xc3: JMP(cpu, imm); break; // JMP adr
+		case 0xc5: PUSH(cpu, "B"); break; // PUSH B
+		case 0xc6: ADD<Flags>(cpu, cpu->a, lo, 0); cpu->pc++; break; // ADI D8
+		case 0xc8: Flags::sync(cpu); // RZ
+			if (!RET_COND(cpu, cpu->cc.z)) cycles_taken = CYCLES_RET_SKIPPED;
+			break;
+		case 0xc9: RET(cpu); break; // RET
+		case 0xca: Flags::sync(cpu); JMP_COND(cpu, imm, cpu->cc.z != 0); break; // JZ adr
+		case 0xcd: CALL(cpu, imm); break; // CALL adr
+		case 0xd1: POP(cpu, "D"); break; // POP D
+		case 0xd2: JMP_COND(cpu, imm, cpu->cc.cy == 0); break; // JNC adr
+		case 0xd3: OUT(cpu, lo); break; // OUT D8
+		case 0xd5: PUSH(cpu, "D"); break; // PUSH D
+		case 0xda: JMP_COND(cpu, imm, cpu->cc.cy != 0); break; // JC adr
+		case 0xdb: IN(cpu, lo); break; // IN D8
+		case 0xe1: POP(cpu, "H"); break; // POP H
+		case 0xe5: PUSH(cpu, "H"); break; // PUSH H
+		case 0xe6: ANA<Flags>(cpu, lo); cpu->pc++; break; // ANI D8
+		case 0xeb: { uint8_t save1 = cpu->d; // XCHG
+			uint8_t save2 = cpu->e;
+			cpu->d = cpu->h;
+			cpu->e = cpu->l;
+			cpu->h = save1;
+			cpu->l = save2; }
+			break;
+		case 0xf1: POP(cpu, "PSW"); break; // POP PSW
+		case 0xf5: Flags::sync(cpu); PUSH(cpu, "PSW"); break; // PUSH PSW
+		case 0xfb: EI(cpu); break; // EI
+		case 0xfe: CMP<Flags>(cpu, lo); cpu->pc++; break; // CPI D8
+		}
+
+		i += cycles_taken;
+		if (i >= cycles || !block->valid) {
+			break;
+		}
+	}
+
+	return i;
+}
+
+template <typename Flags>
+int cpu_run_blocks(CPU* cpu, double cycles) {
+	BlockCache* cache = cpu->blocks;
+	int i = 0;
+
+	while (i < cycles) {
+		Block** table = cache->by_pc[cpu->pc >> 8];
+		Block* block = table ? table[cpu->pc & 0xff] : NULL;
+		if (block == NULL && !is_cold(cache, cpu->pc)) {
+			block = compile(cpu, cpu->pc);
+		}
+
+		if (block == NULL) {
+			i += EmulateI8080_op<NoTrace, Flags>(cpu);
+		}
+		else {
+			i = run_block<Flags>(cpu, block, i, cycles);
+		}
+	}
+
+	free_retired(cache);
+	return i;
+}
+
+template int cpu_run_blocks<EagerFlags>(CPU* cpu, double cycles);
+template int cpu_run_blocks<LazyFlags>(CPU* cpu, double cycles);
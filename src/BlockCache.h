@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+#include "CPU.h"
+
+// Predecoded basic blocks. Straight-line code is decoded once into DecodedOps
+// with their operands already read and assembled, and then run from there
+// instead of being fetched and decoded on every pass.
+
+// One instruction with its operand already read from memory
+struct DecodedOp {
+	uint8_t opcode;
+	uint8_t cycles;
+	uint16_t imm; // D8, D16 or address operand
+};
+
+// A run of instructions up to and including the first jump, call or return,
+// or up to the first instruction the block engine leaves to the interpreter
+struct Block {
+	uint16_t start;
+	int end; // one past the last byte
+	bool valid; // cleared when a store hits the block's code
+	std::vector<DecodedOp> ops;
+};
+
+struct BlockCache {
+	Block** by_pc[256]; // blocks by start address, one 256 entry table per page, allocated on demand
+	std::vector<Block*> on_page[256]; // blocks with code on each page
+	std::vector<Block*> retired; // invalidated, freed once no block is running
+	uint32_t cold[0x10000 / 32]; // one bit per address that can't start a block
+	long compiled;
+	long invalidated;
+};
+
+/*
+	Modifies: cpu->blocks
+	EFFECTS : gives *cpu an empty block cache
+*/
+
+void block_cache_init(CPU* cpu);
+
+/*
+	Modifies: cpu->blocks, cpu->code_pages
+	EFFECTS : frees the block cache of *cpu, if it has one
+*/
+
+void block_cache_free(CPU* cpu);
+
+/*
+	Modifies: cpu->blocks, cpu->code_pages
+	EFFECTS : drops every block with code on page, the next pass through
+			  that code decodes it again
+*/
+
+void block_cache_invalidate(CPU* cpu, uint8_t const page);
+
+/*
+	REQUIRES: block_cache_init(cpu) was called
+	EFFECTS : Same as cpu_run<NoTrace, Flags>, running predecoded blocks.
+			  Instructions the blocks don't cover go to EmulateI8080_op.
+*/
+
+template <typename Flags = EagerFlags>
+int cpu_run_blocks(CPU* cpu, double cycles);
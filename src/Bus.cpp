@@ -0,0 +1,144 @@
+#include <cstring>
+#include "Bus.h"
+
+// What unmapped pages read. Only ever read, every CPU can share it.
+static uint8_t* open_bus() {
+	static uint8_t page[256];
+	static bool const filled = [] {
+		memset(page, 0xff, sizeof(page));
+		return true;
+	}();
+	(void) filled;
+	return page;
+}
+
+// Whether the page of memory source holds predecoded code
+static bool has_code(CPU const* cpu, int const source) {
+	return source >= 0 && ((cpu->code_pages[source >> 5] >> (source & 31)) & 1);
+}
+
+// Fast path pointer of page: the target, unless stores there need more
+static void sync_write_page(CPU* cpu, int const page) {
+	bool const code = has_code(cpu, CPU_memory_page(cpu, cpu->write_target[page]));
+	bool const hooked = cpu->hooks != NULL && cpu->hooks->write[page] != NULL;
+	cpu->write_page[page] = code || hooked ? NULL : cpu->write_target[page];
+}
+
+void CPU_set_code_page(CPU* const cpu, int const page, bool const on) {
+	int const source = CPU_memory_page(cpu, cpu->read_page[page]);
+	if (source < 0 || has_code(cpu, source) == on) {
+		return;
+	}
+
+	if (on) {
+		cpu->code_pages[source >> 5] |= 1u << (source & 31);
+	}
+	else {
+		cpu->code_pages[source >> 5] &= ~(1u << (source & 31));
+	}
+
+	// Every page that stores into source, mirrors included
+	uint8_t const* const target = cpu->memory + (source << 8);
+	for (int other = 0; other < 256; other++) {
+		if (cpu->write_target[other] == target) {
+			sync_write_page(cpu, other);
+		}
+	}
+}
+
+void CPU_write_slow(CPU* const cpu, uint16_t const address, uint8_t const val) {
+	int const page = address >> 8;
+	uint8_t* const target = cpu->write_target[page];
+	target[address & 0xff] = val;
+
+	// Stores ROM ignores leave its code as it is
+	if (has_code(cpu, CPU_memory_page(cpu, target))) {
+		CPU_code_written(cpu, address);
+	}
+	if (cpu->hooks != NULL && cpu->hooks->write[page] != NULL) {
+		cpu->hooks->write[page](cpu, address, val, cpu->hooks->user[page]);
+	}
+}
+
+uint8_t* CPU_fetch_straddling(CPU* const cpu, uint8_t* const scratch) {
+	uint16_t const pc = cpu->pc;
+	scratch[0] = CPU_read(cpu, pc);
+	scratch[1] = CPU_read(cpu, (uint16_t) (pc + 1));
+	scratch[2] = CPU_read(cpu, (uint16_t) (pc + 2));
+	return scratch;
+}
+
+void bus_map_ram(CPU* cpu, uint8_t const page, uint8_t const source) {
+	cpu->read_page[page] = cpu->memory + (source << 8);
+	cpu->write_target[page] = cpu->memory + (source << 8);
+	sync_write_page(cpu, page);
+}
+
+void bus_map_rom(CPU* cpu, uint8_t const page, uint8_t const source) {
+	cpu->read_page[page] = cpu->memory + (source << 8);
+	cpu->write_target[page] = cpu->bus_sink;
+	sync_write_page(cpu, page);
+}
+
+void bus_unmap(CPU* cpu, uint8_t const page) {
+	cpu->read_page[page] = open_bus();
+	cpu->write_target[page] = cpu->bus_sink;
+	sync_write_page(cpu, page);
+}
+
+void bus_map_flat(CPU* cpu) {
+	for (int page = 0; page < 256; page++) {
+		bus_map_ram(cpu, page, page);
+	}
+}
+
+void bus_map_invaders(CPU* cpu) {
+	for (int page = 0; page < 256; page++) {
+		int const source = page & 0x3f;
+		if (source < 0x20) {
+			bus_map_rom(cpu, page, source);
+		}
+		else {
+			bus_map_ram(cpu, page, source);
+		}
+	}
+}
+
+void bus_set_hook(CPU* cpu, uint8_t const page, BusHook hook, void* user) {
+	if (cpu->hooks == NULL) {
+		if (hook == NULL) {
+			return;
+		}
+		cpu->hooks = new BusHooks();
+	}
+
+	cpu->hooks->write[page] = hook;
+	cpu->hooks->user[page] = user;
+	sync_write_page(cpu, page);
+}
+
+// Where p, a page of cpu, lands in copy
+static uint8_t* relocate(uint8_t* p, CPU* copy, CPU const* cpu) {
+	if (p >= cpu->memory && p < cpu->memory + 0x10000) {
+		return copy->memory + (p - cpu->memory);
+	}
+	if (p == cpu->bus_sink) {
+		return copy->bus_sink;
+	}
+	return p;
+}
+
+void bus_clone(CPU* copy, CPU const* cpu) {
+	copy->hooks = NULL;
+	memset(copy->code_pages, 0, sizeof(copy->code_pages));
+	for (int page = 0; page < 256; page++) {
+		copy->read_page[page] = relocate(cpu->read_page[page], copy, cpu);
+		copy->write_target[page] = relocate(cpu->write_target[page], copy, cpu);
+		sync_write_page(copy, page);
+	}
+}
+
+void bus_free(CPU* cpu) {
+	delete cpu->hooks;
+	cpu->hooks = NULL;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "CPU.h"
+
+// Memory maps for the page tables in CPU. A map only decides where the
+// pointers of each 256 byte page go, so it costs nothing per access: a load
+// is two dependent reads on any map, a store the same plus a NULL check.
+// Pages whose stores need more than a write (predecoded code, hooks) have a
+// NULL write pointer and go through CPU_write_slow.
+//
+// Code is tracked by the page of memory it is fetched from, not the address
+// it runs at, so a store through one mirror drops code run through another.
+
+// Called after a store to a page with a hook, val already stored
+typedef void (*BusHook)(CPU* cpu, uint16_t address, uint8_t val, void* user);
+
+struct BusHooks {
+	BusHook write[256];
+	void* user[256];
+};
+
+/*
+	Modifies: page tables of *cpu
+	EFFECTS : maps all 64K as RAM, one to one onto cpu->memory. A new CPU
+			  starts out with this map.
+*/
+
+void bus_map_flat(CPU* cpu);
+
+/*
+	Modifies: page tables of *cpu
+	EFFECTS : maps the Space Invaders board: ROM at 0000-1fff that ignores
+			  stores, 8K of RAM at 2000-3fff, and 4000-ffff mirroring the
+			  first 16K
+*/
+
+void bus_map_invaders(CPU* cpu);
+
+/*
+	Modifies: page tables of *cpu
+	EFFECTS : page reads and stores source's page of cpu->memory
+*/
+
+void bus_map_ram(CPU* cpu, uint8_t page, uint8_t source);
+
+/*
+	Modifies: page tables of *cpu
+	EFFECTS : page reads source's page of cpu->memory and ignores stores
+*/
+
+void bus_map_rom(CPU* cpu, uint8_t page, uint8_t source);
+
+/*
+	Modifies: page tables of *cpu
+	EFFECTS : page reads 0xff and ignores stores
+*/
+
+void bus_unmap(CPU* cpu, uint8_t page);
+
+/*
+	Modifies: cpu->hooks, page tables of *cpu
+	EFFECTS : calls hook with user after every store to page, for
+			  watchpoints and dirty tracking. A NULL hook removes it.
+*/
+
+void bus_set_hook(CPU* cpu, uint8_t page, BusHook hook, void* user);
+
+/*
+	REQUIRES: copy is a byte copy of *cpu with its own memory
+	Modifies: page tables of *copy, copy->hooks, copy->code_pages
+	EFFECTS : points copy's map at its own memory, with no code pages and
+			  no hooks
+*/
+
+void bus_clone(CPU* copy, CPU const* cpu);
+
+/*
+	Modifies: cpu->hooks
+	EFFECTS : frees the hooks of *cpu
+*/
+
+void bus_free(CPU* cpu);
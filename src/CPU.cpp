@@ -1,40 +1,18 @@
 #include <cassert>
 #include <cstdint>
+#include <cstring>
+#include "CPU.h"
 #include "Disassembler.h"
-#include "display.h"
-
-double const TIC =  (1000.0 / 60.0);  // Milliseconds per tic 60FPS
-double const CYCLES_PER_MS = 2000;  // 8080 runs at 2 MHz
-double const CYCLES_PER_TIC = (CYCLES_PER_MS * TIC);
-
-struct ConditionCodes {
-	uint8_t z : 1; // Z (zero) set to 1 when the result is equal to zero
-	uint8_t s : 1; // S (sign) set to 1 when bit 7 (the most significant bit or MSB) of the math instruction is set
-	uint8_t p : 1; // P (parity) is set when the answer has even parity, clear when odd parity
-	uint8_t cy : 1; // CY (carry) set to 1 when the instruction resulted in a carry out or borrow into the high order bit
-	uint8_t ac : 1; // AC (auxillary carry) is used for BCD (binary coded decimal) math, not needed for space invaders
-	uint8_t pad : 3; // Not sure
-};
-
-struct CPU {
-	uint8_t a;
-	uint8_t b;
-	uint8_t c;
-	uint8_t d; // Registry Locations
-	uint8_t e;
-	uint8_t h;
-	uint8_t l;
-	uint16_t sp; // Stack Pointer
-	uint16_t pc; // Program Counter
-	uint8_t* memory; // Memory Buffer
-	ConditionCodes cc; 
-	uint8_t ports[9] = { 0,0,0,0,0,0,0,0,0 };
-	uint8_t int_enable; // interrupt
-};
-
-uint8_t     shift0;         //LSB of Space Invader's external shift hardware
-uint8_t     shift1;         //MSB
-uint8_t     shift_offset;         // offset for external shift hardware
+#include "Flags.h"
+#include "Files.h"
+#include "BlockCache.h"
+#include "Jit.h"
+#include "Memory.h"
+#include "Bus.h"
+#include "Ports.h"
+#include "Trace.h"
+#include "OpCounts.h"
+#include "Profiler.h"
 
 unsigned char cycles8080[] = {
 	4, 10, 7, 5, 5, 5, 7, 4, 4, 10, 7, 5, 5, 5, 7, 4, //0x00..0x0f
@@ -58,29 +36,100 @@ unsigned char cycles8080[] = {
 	11, 10, 10, 4, 17, 11, 7, 11, 11, 5, 10, 4, 17, 17, 7, 11,
 };
 
+// Bytes per instruction, opcode included
+unsigned char lengths8080[] = {
+	1, 3, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, //0x00..0x0f
+	1, 3, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1,
+	1, 3, 3, 1, 1, 1, 2, 1, 1, 1, 3, 1, 1, 1, 2, 1,
+	1, 3, 3, 1, 1, 1, 2, 1, 1, 1, 3, 1, 1, 1, 2, 1,
+
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, //0x40..0x4f
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, //0x80..0x8f
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+
+	1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, 3, 3, 3, 2, 1, //0xc0..0xcf
+	1, 1, 3, 2, 3, 1, 2, 1, 1, 1, 3, 2, 3, 3, 2, 1,
+	1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 3, 2, 1,
+	1, 1, 3, 1, 3, 1, 2, 1, 1, 1, 3, 1, 3, 3, 2, 1,
+};
+
 
 
 CPU* CPU_INIT()
 {
 	CPU* cpu = (CPU*) calloc(1, sizeof(CPU));
-	cpu->memory = (uint8_t*) malloc(0x10000);  //16K
+	uint8_t* memory = memory_alloc();  // 64K, zeroed so runs repeat exactly
+	if (cpu == NULL || memory == NULL) {
+		printf("error: Couldn't allocate memory for a CPU\n");
+		free(cpu);
+		if (memory != NULL) {
+			memory_free(memory);
+		}
+		return NULL;
+	}
+
+	cpu->memory = memory;
 	cpu->int_enable = 1;
+	bus_map_flat(cpu);
+	cpu->io = port_map_invaders();
 	return cpu;
 }
 
-// Helper Functions //
+void CPU_free(CPU* cpu) {
+	bus_free(cpu);
+	memory_free(cpu->memory);
+	free(cpu);
+}
 
-bool parity(uint8_t x) {
-	// https://stackoverflow.com/a/21618054/11287626
-	uint8_t count = 0, i, b = 1;
+// Helper Functions //
 
-	for (i = 0; i < 8; i++) {
-		if (x & (b << i)) { count++; }
+CPU* CPU_clone(CPU const* cpu) {
+	CPU* copy = (CPU*) malloc(sizeof(CPU));
+	uint8_t* memory = memory_alloc();
+	if (copy == NULL || memory == NULL) {
+		printf("error: Couldn't allocate memory for a copy of the CPU\n");
+		free(copy);
+		if (memory != NULL) {
+			memory_free(memory);
+		}
+		return NULL;
 	}
 
-	if ((count % 2)) { return false; }
+	*copy = *cpu;
+	copy->memory = memory;
+	memcpy(copy->memory, cpu->memory, 0x10000);
+	copy->blocks = NULL;  // predecoded and native code is not shared
+	copy->jit = NULL;
+	copy->trace = NULL;
+	copy->counts = NULL;
+	copy->profile = NULL;
+	bus_clone(copy, cpu);
+	return copy;
+}
+
+void CPU_code_written(CPU* const cpu, uint16_t const address) {
+	// The engines keep code by the address it runs at, which may be any
+	// page that reads the memory written
+	uint8_t const* const target = cpu->write_target[address >> 8];
+	for (int page = 0; page < 256; page++) {
+		if (cpu->read_page[page] == target) {
+			block_cache_invalidate(cpu, page);
+			jit_invalidate(cpu, page);
+
+			// Ahead-of-time code can't be dropped, clearing the bit retires the page
+			CPU_set_code_page(cpu, page, false);
+		}
+	}
+}
 
-	return true;
+void CPU_sync_flags(CPU* const cpu) {
+	LazyFlags::sync(cpu);
 }
 
 ////////////////////////////Intel 8080 CPU Instructions/////////////////////////
@@ -93,22 +142,26 @@ void MOV(uint8_t &dst, uint8_t const src) {
 
 // Arithmetic //
 
+template <typename Flags>
 void ADD(CPU* const cpu, uint8_t const a, uint8_t const val, bool const cy) {
-	uint16_t answer = (uint16_t)a + (uint16_t)val + cy;
-	cpu->cc.z = ((answer & 0xff) == 0);
-	cpu->cc.s = ((answer & 0x80) != 0);
-	cpu->cc.cy = (answer > 0xff);
-	cpu->cc.p = parity(answer & 0xff);
-	cpu->a = answer & 0xff;
+	uint8_t answer = a + val + cy;
+	cpu->cc.cy = CY_ADD[carry_index(a, val, answer) >> 4];
+	Flags::result(cpu, FLAGS_ADD, a, val, answer);
+	cpu->a = answer;
 }
 
+template <typename Flags>
 void SUB(CPU* const cpu, uint8_t const a, uint8_t const val, bool const cy) {
-	// https://stackoverflow.com/a/8037485
-	ADD(cpu, a, ~val, !cy);
-	cpu->cc.cy = !cpu->cc.cy;
+	uint8_t answer = a - val - cy;
+	cpu->cc.cy = CY_SUB[carry_index(a, val, answer) >> 4];
+	Flags::result(cpu, FLAGS_SUB, a, val, answer);
+	cpu->a = answer;
 }
 
+template <typename Flags>
 void DAA(CPU* cpu) {
+	Flags::sync(cpu);
+
 	bool cy = cpu->cc.cy;
 	uint8_t value_to_add = 0;
 
@@ -122,8 +175,7 @@ void DAA(CPU* cpu) {
 		value_to_add += 0x60;
 		cy = 1;
 	}
-	ADD(cpu, cpu->a, value_to_add, 0);
-	cpu->cc.p = parity(cpu->a);
+	ADD<Flags>(cpu, cpu->a, value_to_add, 0);
 	cpu->cc.cy = cy;
 }
 
@@ -160,17 +212,17 @@ void DAD(CPU* const cpu, uint16_t const val) {
 	CPU_set_hl(cpu, CPU_get_hl(cpu) + val);
 }
 
-void INR(CPU* const cpu, uint8_t const &reg) {
-	uint8_t carry = cpu->cc.cy;
-	ADD(cpu, reg, 1, false);
-	cpu->cc.cy = carry;
+template <typename Flags>
+void INR(CPU* const cpu, uint8_t &reg) {
+	uint8_t res = reg + 1;
+	Flags::result(cpu, FLAGS_ADD, reg, 1, res);
+	reg = res;
 }
 
+template <typename Flags>
 void DCR(CPU* const cpu, uint8_t &reg) {
 	uint8_t res = reg - 1;
-	cpu->cc.z = (res == 0);
-	cpu->cc.s = (0x80 == (res & 0x80));
-	cpu->cc.p = parity(res);
+	Flags::result(cpu, FLAGS_SUB, reg, 1, res);
 	reg = res;
 }
 
@@ -210,37 +262,33 @@ void RAR(CPU* const cpu) {
 	cpu->a = (cpu->a >> 1) | (cy << 7);
 }
 
+template <typename Flags>
 void ANA(CPU* const cpu, uint8_t const address) {
 	uint8_t answer = cpu->a & address;
-	cpu->cc.z = ((answer) == 0);
-	cpu->cc.s = (0x80 == (answer & 0x80));
 	cpu->cc.cy = 0;
-	cpu->cc.p = parity(answer);
+	Flags::result(cpu, FLAGS_ANA, cpu->a, address, answer);
 	cpu->a = answer;
 }
 
+template <typename Flags>
 void XRA(CPU* const cpu, uint8_t const address) {
 	cpu->a ^= address;
-	cpu->cc.z = ((cpu->a) == 0);
-	cpu->cc.s = (0x80 == (cpu->a & 0x80));
 	cpu->cc.cy = 0;
-	cpu->cc.p = parity(cpu->a);
+	Flags::result(cpu, FLAGS_LOGIC, 0, 0, cpu->a);
 }
 
+template <typename Flags>
 void ORA(CPU* const cpu, uint8_t const address) {
 	cpu->a |= address;
-	cpu->cc.z = ((cpu->a) == 0);
-	cpu->cc.s = (0x80 == (cpu->a & 0x80));
 	cpu->cc.cy = 0;
-	cpu->cc.p = parity(cpu->a);
+	Flags::result(cpu, FLAGS_LOGIC, 0, 0, cpu->a);
 }
 
+template <typename Flags>
 void CMP(CPU* const cpu, uint8_t const address) {
-	int16_t answer = cpu->a - address;
-	cpu->cc.z = ((answer) == 0);
-	cpu->cc.s = (0x80 == (answer & 0x80));
-	cpu->cc.cy = (cpu->a < answer);
-	cpu->cc.p = parity(answer);
+	uint8_t answer = cpu->a - address;
+	cpu->cc.cy = CY_SUB[carry_index(cpu->a, address, answer) >> 4];
+	Flags::result(cpu, FLAGS_SUB, cpu->a, address, answer);
 }
 
 // Branch
@@ -260,129 +308,106 @@ void JMP_COND(CPU* const cpu, uint16_t const address, bool const condition) {
 
 void CALL(CPU* const cpu, uint16_t const address) {
 	uint16_t    ret = cpu->pc + 2;
-	cpu->memory[cpu->sp - 1] = (ret >> 8) & 0xff;
-	cpu->memory[cpu->sp - 2] = (ret & 0xff);
+	CPU_write(cpu, cpu->sp - 1, (ret >> 8) & 0xff);
+	CPU_write(cpu, cpu->sp - 2, (ret & 0xff));
 	cpu->sp = cpu->sp - 2;
 	cpu->pc = address;
 }
 
-void CALL_COND(CPU* const cpu, uint16_t const address, bool const condition) {
+bool CALL_COND(CPU* const cpu, uint16_t const address, bool const condition) {
 	if (condition) {
 		CALL(cpu, address);
 	}
 	else {
 		cpu->pc += 2;
 	}
+	return condition;
 }
 
 void RET(CPU* const cpu) {
-	cpu->pc = cpu->memory[cpu->sp] | (cpu->memory[cpu->sp + 1] << 8);
+	cpu->pc = CPU_read(cpu, cpu->sp) | (CPU_read(cpu, cpu->sp + 1) << 8);
 	cpu->sp += 2;
 }
 
-void RET_COND(CPU* const cpu, bool const condition) {
+bool RET_COND(CPU* const cpu, bool const condition) {
 	if (condition)
 		RET(cpu);
+	return condition;
 }
 
 // Stack
 
 void PUSH(CPU* cpu, std::string registry) {
 	if (registry == "B") {
-		cpu->memory[cpu->sp - 1] = cpu->b;
-		cpu->memory[cpu->sp - 2] = cpu->c;
+		CPU_write(cpu, cpu->sp - 1, cpu->b);
+		CPU_write(cpu, cpu->sp - 2, cpu->c);
 		cpu->sp -= 2;
 	}
 	else if (registry == "D") {
-		cpu->memory[cpu->sp - 1] = cpu->d;
-		cpu->memory[cpu->sp - 2] = cpu->e;
+		CPU_write(cpu, cpu->sp - 1, cpu->d);
+		CPU_write(cpu, cpu->sp - 2, cpu->e);
 		cpu->sp -= 2;
 	}
 	else if (registry == "H") {
-		cpu->memory[cpu->sp - 1] = cpu->h;
-		cpu->memory[cpu->sp - 2] = cpu->l;
+		CPU_write(cpu, cpu->sp - 1, cpu->h);
+		CPU_write(cpu, cpu->sp - 2, cpu->l);
 		cpu->sp -= 2;
 	}
 	else if (registry == "PSW") {
-		cpu->memory[cpu->sp - 1] = cpu->a;
+		CPU_write(cpu, cpu->sp - 1, cpu->a);
 		uint8_t psw = (cpu->cc.z |
 			cpu->cc.s << 1 |
 			cpu->cc.p << 2 |
 			cpu->cc.cy << 3 |
 			cpu->cc.ac << 4);
-		cpu->memory[cpu->sp - 2] = psw;
+		CPU_write(cpu, cpu->sp - 2, psw);
 		cpu->sp -= 2;
 	}
 	else if (registry == "PC") {
-		cpu->memory[cpu->sp - 1] = (cpu->pc & 0xFF00) >> 8;
-		cpu->memory[cpu->sp - 2] = (cpu->pc & 0xff);
+		CPU_write(cpu, cpu->sp - 1, (cpu->pc & 0xFF00) >> 8);
+		CPU_write(cpu, cpu->sp - 2, (cpu->pc & 0xff));
 		cpu->sp -= 2;
 	}
 }
 
 void POP(CPU* cpu, std::string registry) {
 	if (registry == "B") {
-		cpu->c = cpu->memory[cpu->sp];
-		cpu->b = cpu->memory[cpu->sp + 1];
+		cpu->c = CPU_read(cpu, cpu->sp);
+		cpu->b = CPU_read(cpu, cpu->sp + 1);
 		cpu->sp += 2;
 	}
 	else if (registry == "D") {
-		cpu->e = cpu->memory[cpu->sp];
-		cpu->d = cpu->memory[cpu->sp + 1];
+		cpu->e = CPU_read(cpu, cpu->sp);
+		cpu->d = CPU_read(cpu, cpu->sp + 1);
 		cpu->sp += 2;
 	}
 	else if (registry == "H") {
-		cpu->l = cpu->memory[cpu->sp];
-		cpu->h = cpu->memory[cpu->sp + 1];
+		cpu->l = CPU_read(cpu, cpu->sp);
+		cpu->h = CPU_read(cpu, cpu->sp + 1);
 		cpu->sp += 2;
 	}
 	else if (registry == "PSW") {
-		cpu->a = cpu->memory[cpu->sp + 1];
-		uint8_t psw = cpu->memory[cpu->sp];
+		cpu->a = CPU_read(cpu, cpu->sp + 1);
+		uint8_t psw = CPU_read(cpu, cpu->sp);
 		cpu->cc.z = (0x01 == (psw & 0x01));
 		cpu->cc.s = (0x02 == (psw & 0x02));
 		cpu->cc.p = (0x04 == (psw & 0x04));
 		cpu->cc.cy = (0x05 == (psw & 0x08));
 		cpu->cc.ac = (0x10 == (psw & 0x10));
+		cpu->pending.kind = FLAGS_NONE;
 		cpu->sp += 2;
 	}
 }
 
 // I/O
 
-void IN(CPU* const cpu, uint8_t port) {
-	
-	switch (port)
-	{
-	case 0:
-		cpu->a = 1;
-	case 1:
-		cpu->a = cpu->ports[1];
-	case 3:
-	{
-		uint16_t v = (shift1 << 8) | shift0;
-		cpu->a = ((v >> (8 - shift_offset)) & 0xff);
-	}
-	break;
-	}
-
+void IN(CPU* const cpu, uint8_t const port) {
+	cpu->a = cpu->io->read[port](cpu, port);
 	cpu->pc++;
 }
 
-void OUT(CPU* cpu, uint8_t &port) {
-	switch (port)
-	{
-	case 2:
-		shift_offset = cpu->a & 0x7;
-		break;
-	case 4:
-		shift0 = shift1;
-		shift1 = cpu->a;
-		break;
-	}
-
-	port = cpu->a;
-
+void OUT(CPU* const cpu, uint8_t const port) {
+	cpu->io->write[port](cpu, port, cpu->a);
 	cpu->pc++;
 }
 
@@ -401,6 +426,28 @@ void NOP(CPU* const cpu) {
 }
 
 
+// Trace
+
+void PrintTrace::instruction(CPU* const cpu) {
+	disassemble_8080_op_code(cpu->memory, cpu->pc);
+}
+
+void PrintTrace::registers(CPU* const cpu, int const cycles) {
+	CPU_sync_flags(cpu);
+	printf("\t");
+	printf("%c", cpu->cc.z ? 'z' : '.');
+	printf("%c", cpu->cc.s ? 's' : '.');
+	printf("%c", cpu->cc.p ? 'p' : '.');
+	printf("%c", cpu->cc.cy ? 'c' : '.');
+	printf("%c  ", cpu->cc.ac ? 'a' : '.');
+	printf("A $%02x B $%02x C $%02x D $%02x E $%02x H $%02x L $%02x SP %04x\n", cpu->a, cpu->b, cpu->c,
+		cpu->d, cpu->e, cpu->h, cpu->l, cpu->sp);
+}
+
+void PrintTrace::cycles(int const i) {
+	std::cout << "Cycles: " << i << std::endl;
+}
+
 /*
 	REQUIRES: *cpu is a valid pointer to a CPU data type
 	Modifies: pc
@@ -413,8 +460,7 @@ void UnimplementedInstruction(CPU* const cpu) {
 	cpu->pc--;
 	disassemble_8080_op_code(cpu->memory, cpu->pc);
 	printf("\n");
-	free(cpu->memory);
-	free(cpu);
+	CPU_free(cpu);
 	assert(false);
 }
 
@@ -424,12 +470,15 @@ void UnimplementedInstruction(CPU* const cpu) {
 	EFFECTS : Runs instructions with their respective opcodes from CPU::memory
 */
 
+template <typename Trace, typename Flags>
 int EmulateI8080_op(CPU* const cpu)
 {
 
-	unsigned char* opcode = &cpu->memory[cpu->pc];
+	uint8_t fetched[3];
+	unsigned char* opcode = CPU_fetch(cpu, fetched);
+	int cycles = cycles8080[*opcode];
 
-	disassemble_8080_op_code(cpu->memory, cpu->pc);
+	Trace::instruction(cpu);
 
 	cpu->pc += 1;  //advance the program counter for the next opcode
 
@@ -446,7 +495,7 @@ int EmulateI8080_op(CPU* const cpu)
 	case 0x03: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0x04: UnimplementedInstruction(cpu); return 0; ; break;
 	
-	case 0x05: DCR(cpu, cpu->b); break; // DCR B
+	case 0x05: DCR<Flags>(cpu, cpu->b); break; // DCR B
 
 	case 0x06: MOV(cpu->b, opcode[1]); cpu->pc++; break; // MVI B, D8
 
@@ -459,7 +508,7 @@ int EmulateI8080_op(CPU* const cpu)
 	case 0x0b: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0x0c: UnimplementedInstruction(cpu); return 0; ; break;
 
-	case 0x0d: DCR(cpu, cpu->c); break; // DCR C
+	case 0x0d: DCR<Flags>(cpu, cpu->c); break; // DCR C
 
 	case 0x0e: MOV(cpu->c, opcode[1]); cpu->pc++; break; // MVI C, D8
 
@@ -484,7 +533,7 @@ int EmulateI8080_op(CPU* const cpu)
 
 	case 0x19: DAD(cpu, CPU_get_de(cpu)); break; // DAD D
 
-	case 0x1a: MOV(cpu->a, cpu->memory[CPU_get_de(cpu)]); // LDAX D
+	case 0x1a: MOV(cpu->a, CPU_read(cpu, CPU_get_de(cpu))); // LDAX D
 			   break;
 
 	case 0x1b: UnimplementedInstruction(cpu); return 0; ; break;
@@ -510,7 +559,7 @@ int EmulateI8080_op(CPU* const cpu)
 
 	case 0x26: MOV(cpu->h, opcode[1]); cpu->pc++; break; // MVI H, D8
 
-	case 0x27: DAA(cpu); break; // DAA
+	case 0x27: DAA<Flags>(cpu); break; // DAA
 
 	case 0x28: UnimplementedInstruction(cpu); return 0; ; break;
 
@@ -528,7 +577,7 @@ int EmulateI8080_op(CPU* const cpu)
 		       cpu->pc += 2;
 			   break;
 
-	case 0x32: MOV(cpu->memory[(opcode[2] << 8) | (opcode[1])], cpu->a); //STA adr
+	case 0x32: CPU_write(cpu, (opcode[2] << 8) | (opcode[1]), cpu->a); //STA adr
 			   cpu->pc += 2; 
 			   break;
 
@@ -536,7 +585,7 @@ int EmulateI8080_op(CPU* const cpu)
 	case 0x34: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0x35: CPU_set_hl(cpu, CPU_get_hl(cpu)-1); break; // DCR M
 
-	case 0x36: MOV(cpu->memory[CPU_get_hl(cpu)], opcode[1]); // MVI M, D8
+	case 0x36: CPU_write(cpu, CPU_get_hl(cpu), opcode[1]); // MVI M, D8
 		       cpu->pc++; 
 			   break;
 
@@ -544,14 +593,14 @@ int EmulateI8080_op(CPU* const cpu)
 	case 0x38: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0x39: UnimplementedInstruction(cpu); return 0; ; break;
 
-	case 0x3a: MOV(cpu->a, cpu->memory[(opcode[2] << 8) | (opcode[1])]); // LDA adr
+	case 0x3a: MOV(cpu->a, CPU_read(cpu, (opcode[2] << 8) | (opcode[1]))); // LDA adr
 			   cpu->pc += 2; 
 			   break;
 
 	case 0x3b: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0x3c: UnimplementedInstruction(cpu); return 0; ; break;
 
-	case 0x3d: DCR(cpu, cpu->a); break; // DCR A
+	case 0x3d: DCR<Flags>(cpu, cpu->a); break; // DCR A
 
 	case 0x3e: MOV(cpu->a, opcode[1]); cpu->pc++; break; // MVI A, D8
 
@@ -579,7 +628,7 @@ int EmulateI8080_op(CPU* const cpu)
 	case 0x54: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0x55: UnimplementedInstruction(cpu); return 0; ; break;
 
-	case 0x56: MOV(cpu->d, cpu->memory[CPU_get_hl(cpu)]); break; // MOV D, M
+	case 0x56: MOV(cpu->d, CPU_read(cpu, CPU_get_hl(cpu))); break; // MOV D, M
 
 	case 0x57: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0x58: UnimplementedInstruction(cpu); return 0; ; break;
@@ -589,7 +638,7 @@ int EmulateI8080_op(CPU* const cpu)
 	case 0x5c: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0x5d: UnimplementedInstruction(cpu); return 0; ; break;
 
-	case 0x5e: MOV(cpu->e, cpu->memory[CPU_get_hl(cpu)]); break; // MOV E, M
+	case 0x5e: MOV(cpu->e, CPU_read(cpu, CPU_get_hl(cpu))); break; // MOV E, M
 
 	case 0x5f: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0x60: UnimplementedInstruction(cpu); return 0; ; break;
@@ -599,7 +648,7 @@ int EmulateI8080_op(CPU* const cpu)
 	case 0x64: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0x65: UnimplementedInstruction(cpu); return 0; ; break;
 
-	case 0x66: MOV(cpu->h, cpu->memory[CPU_get_hl(cpu)]); break; // MOV H, M
+	case 0x66: MOV(cpu->h, CPU_read(cpu, CPU_get_hl(cpu))); break; // MOV H, M
 
 	case 0x67: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0x68: UnimplementedInstruction(cpu); return 0; ; break;
@@ -620,7 +669,7 @@ int EmulateI8080_op(CPU* const cpu)
 	case 0x75: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0x76: UnimplementedInstruction(cpu); return 0; ; break;
 	
-	case 0x77: MOV(cpu->memory[CPU_get_hl(cpu)], cpu->a); break; // MOV M, A
+	case 0x77: CPU_write(cpu, CPU_get_hl(cpu), cpu->a); break; // MOV M, A
 
 	case 0x78: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0x79: UnimplementedInstruction(cpu); return 0; ; break;
@@ -633,7 +682,7 @@ int EmulateI8080_op(CPU* const cpu)
 
 	case 0x7d: MOV(cpu->a, cpu->l); break; // MOV A, L
 
-	case 0x7e: MOV(cpu->a, cpu->memory[CPU_get_hl(cpu)]); break; // MOV A, M
+	case 0x7e: MOV(cpu->a, CPU_read(cpu, CPU_get_hl(cpu))); break; // MOV A, M
 
 	case 0x7f: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0x80: UnimplementedInstruction(cpu); return 0; ; break;
@@ -676,7 +725,7 @@ int EmulateI8080_op(CPU* const cpu)
 	case 0xa5: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0xa6: UnimplementedInstruction(cpu); return 0; ; break;
 
-	case 0xa7: ANA(cpu, cpu->a); break; // ANA A
+	case 0xa7: ANA<Flags>(cpu, cpu->a); break; // ANA A
 
 	case 0xa8: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0xa9: UnimplementedInstruction(cpu); return 0; ; break;
@@ -686,7 +735,7 @@ int EmulateI8080_op(CPU* const cpu)
 	case 0xad: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0xae: UnimplementedInstruction(cpu); return 0; ; break;
 
-	case 0xaf: XRA(cpu, cpu->a); break; // XRA A
+	case 0xaf: XRA<Flags>(cpu, cpu->a); break; // XRA A
 
 	case 0xb0: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0xb1: UnimplementedInstruction(cpu); return 0; ; break;
@@ -705,11 +754,13 @@ int EmulateI8080_op(CPU* const cpu)
 	case 0xbe: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0xbf: UnimplementedInstruction(cpu); return 0; ; break;
 
-	case 0xc0: RET_COND(cpu, cpu->cc.z != 0) ; break; // RNZ
+	case 0xc0: Flags::sync(cpu); // RNZ
+			   if (!RET_COND(cpu, cpu->cc.z != 0)) cycles = CYCLES_RET_SKIPPED;
+			   break;
 
 	case 0xc1: POP(cpu, "B"); break; // POP B
 
-	case 0xc2: JMP_COND(cpu, (opcode[2] << 8) | opcode[1], 0 == cpu->cc.z); break; // JNZ adr
+	case 0xc2: Flags::sync(cpu); JMP_COND(cpu, (opcode[2] << 8) | opcode[1], 0 == cpu->cc.z); break; // JNZ adr
 
 	case 0xc3: JMP(cpu, (opcode[2] << 8) | opcode[1]); break; // JMP adr
 
@@ -717,15 +768,17 @@ int EmulateI8080_op(CPU* const cpu)
 
 	case 0xc5: PUSH(cpu, "B"); break; // PUSH B
 
-	case 0xc6: ADD(cpu, cpu->a, opcode[1], 0); cpu->pc++;  break; // ADI D8
+	case 0xc6: ADD<Flags>(cpu, cpu->a, opcode[1], 0); cpu->pc++;  break; // ADI D8
 
 	case 0xc7: UnimplementedInstruction(cpu); return 0; ; break;
 
-	case 0xc8: RET_COND(cpu, cpu->cc.z); break; // RET
+	case 0xc8: Flags::sync(cpu); // RZ
+			   if (!RET_COND(cpu, cpu->cc.z)) cycles = CYCLES_RET_SKIPPED;
+			   break;
 
  	case 0xc9: RET(cpu); break; // RET
 
-	case 0xca: JMP_COND(cpu, (opcode[2] << 8) | opcode[1], cpu->cc.z != 0); break; // JZ adr
+	case 0xca: Flags::sync(cpu); JMP_COND(cpu, (opcode[2] << 8) | opcode[1], cpu->cc.z != 0); break; // JZ adr
 
 	case 0xcb: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0xcc: UnimplementedInstruction(cpu); return 0; ; break;
@@ -769,7 +822,7 @@ int EmulateI8080_op(CPU* const cpu)
 
 	case 0xe5: PUSH(cpu, "H"); break; // PUSH H
 
-	case 0xe6: ANA(cpu, opcode[1]); cpu->pc++;  break; // ANI D8
+	case 0xe6: ANA<Flags>(cpu, opcode[1]); cpu->pc++;  break; // ANI D8
 
 	case 0xe7: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0xe8: UnimplementedInstruction(cpu); return 0; ; break;
@@ -797,7 +850,7 @@ int EmulateI8080_op(CPU* const cpu)
 	case 0xf3: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0xf4: UnimplementedInstruction(cpu); return 0; ; break;
 
-	case 0xf5: PUSH(cpu, "PSW"); break; // PUSH PSW
+	case 0xf5: Flags::sync(cpu); PUSH(cpu, "PSW"); break; // PUSH PSW
 
 	case 0xf6: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0xf7: UnimplementedInstruction(cpu); return 0; ; break;
@@ -810,48 +863,46 @@ int EmulateI8080_op(CPU* const cpu)
 	case 0xfc: UnimplementedInstruction(cpu); return 0; ; break;
 	case 0xfd: UnimplementedInstruction(cpu); return 0; ; break;
 
-	case 0xfe: CMP(cpu, opcode[1]); cpu->pc++; break; // CPI D8
+	case 0xfe: CMP<Flags>(cpu, opcode[1]); cpu->pc++; break; // CPI D8
 
 	case 0xff: UnimplementedInstruction(cpu); return 0; ; break;
 	}
 
-	printf("\t");
-	printf("%c", cpu->cc.z ? 'z' : '.');
-	printf("%c", cpu->cc.s ? 's' : '.');
-	printf("%c", cpu->cc.p ? 'p' : '.');
-	printf("%c", cpu->cc.cy ? 'c' : '.');
-	printf("%c  ", cpu->cc.ac ? 'a' : '.');
-	printf("A $%02x B $%02x C $%02x D $%02x E $%02x H $%02x L $%02x SP %04x\n", cpu->a, cpu->b, cpu->c,
-		cpu->d, cpu->e, cpu->h, cpu->l, cpu->sp);
+	Trace::registers(cpu, cycles);
 
-	return cycles8080[*opcode];
+	return cycles;
 }
 
-void ReadFileIntoMemoryAt(CPU* cpu, std::string filename)
+bool ReadFileIntoMemoryAt(CPU* cpu, std::string filename)
 {
-	FILE* f;
-	fopen_s(&f, filename.c_str(), "rb");
+	FILE* f = file_open(filename.c_str(), "rb");
 	if (f == NULL)
 	{
 		printf("error: Couldn't open %s\n", filename.c_str());
-		assert(false);
-	} else {
-		fseek(f, 0L, SEEK_END);
-		int fsize = ftell(f);
-		fseek(f, 0L, SEEK_SET);
-
-		uint8_t* buffer = &cpu->memory[0];
-		fread(buffer, fsize, 1, f);
-		fclose(f);
+		return false;
 	}
+
+	fseek(f, 0L, SEEK_END);
+	long fsize = ftell(f);
+	fseek(f, 0L, SEEK_SET);
+	if (fsize > 0x10000) {
+		fsize = 0x10000;
+	}
+
+	uint8_t* buffer = &cpu->memory[0];
+	fread(buffer, fsize, 1, f);
+	fclose(f);
+	return true;
 }
 
-void cpu_run(CPU* cpu, double cycles) {
+template <typename Trace, typename Flags>
+int cpu_run(CPU* cpu, double cycles) {
 	int i = 0;
 	while (i < cycles) {
-		std::cout << "Cycles: " << i << std::endl;
-		i += EmulateI8080_op(cpu);
+		Trace::cycles(i);
+		i += EmulateI8080_op<Trace, Flags>(cpu);
 	}
+	return i;
 }
 
 void generate_interrupt(CPU* cpu, int interrupt_num)
@@ -866,42 +917,45 @@ void generate_interrupt(CPU* cpu, int interrupt_num)
 	DI(cpu);
 }
 
-int main(int argc, char *argv[]) {
-
-	CPU* cpu = CPU_INIT();
-	display_init();
-
-	ReadFileIntoMemoryAt(cpu, "C:/Users/Hernandez/Desktop/8080ROM/invaders");
-
-	uint32_t last_tic = SDL_GetTicks();  // milliseconds
-	while (1) {
-		if ((SDL_GetTicks() - last_tic) >= TIC) {
-			last_tic = SDL_GetTicks();
-
-			cpu_run(cpu, (CYCLES_PER_TIC / 2));
-
-			if (cpu->int_enable) {
-				generate_interrupt(cpu, 0x08);
-			}
-
-			cpu_run(cpu, (CYCLES_PER_TIC / 2));
-
-			handle_input(cpu->ports);
-			draw_video_ram(cpu->memory);
-
-			if (cpu->int_enable) {
-				generate_interrupt(cpu, 0x10);
-			}
-
-
-			if (SDL_GetTicks() - last_tic > TIC) {
-				puts("Too slow!");
-			}
-		}
-	}
-
-	free(cpu->memory);
-	free(cpu);
-
-	return 0;
-}
+// Only these instantiations exist; NoTrace is the emulator, PrintTrace the
+// debug build, RingTrace the --trace run, CountTrace the --count-ops run and
+// CoverTrace the --profile run.
+template int EmulateI8080_op<NoTrace, EagerFlags>(CPU* const cpu);
+template int EmulateI8080_op<NoTrace, LazyFlags>(CPU* const cpu);
+template int EmulateI8080_op<PrintTrace, EagerFlags>(CPU* const cpu);
+template int EmulateI8080_op<PrintTrace, LazyFlags>(CPU* const cpu);
+template int EmulateI8080_op<RingTrace, EagerFlags>(CPU* const cpu);
+template int EmulateI8080_op<RingTrace, LazyFlags>(CPU* const cpu);
+template int EmulateI8080_op<CountTrace, EagerFlags>(CPU* const cpu);
+template int EmulateI8080_op<CountTrace, LazyFlags>(CPU* const cpu);
+template int EmulateI8080_op<CoverTrace, EagerFlags>(CPU* const cpu);
+template int EmulateI8080_op<CoverTrace, LazyFlags>(CPU* const cpu);
+template int cpu_run<NoTrace, EagerFlags>(CPU* cpu, double cycles);
+template int cpu_run<NoTrace, LazyFlags>(CPU* cpu, double cycles);
+template int cpu_run<PrintTrace, EagerFlags>(CPU* cpu, double cycles);
+template int cpu_run<PrintTrace, LazyFlags>(CPU* cpu, double cycles);
+template int cpu_run<RingTrace, EagerFlags>(CPU* cpu, double cycles);
+template int cpu_run<RingTrace, LazyFlags>(CPU* cpu, double cycles);
+template int cpu_run<CountTrace, EagerFlags>(CPU* cpu, double cycles);
+template int cpu_run<CountTrace, LazyFlags>(CPU* cpu, double cycles);
+template int cpu_run<CoverTrace, EagerFlags>(CPU* cpu, double cycles);
+template int cpu_run<CoverTrace, LazyFlags>(CPU* cpu, double cycles);
+
+template void ADD<EagerFlags>(CPU* const cpu, uint8_t const a, uint8_t const val, bool const cy);
+template void ADD<LazyFlags>(CPU* const cpu, uint8_t const a, uint8_t const val, bool const cy);
+template void SUB<EagerFlags>(CPU* const cpu, uint8_t const a, uint8_t const val, bool const cy);
+template void SUB<LazyFlags>(CPU* const cpu, uint8_t const a, uint8_t const val, bool const cy);
+template void DAA<EagerFlags>(CPU* cpu);
+template void DAA<LazyFlags>(CPU* cpu);
+template void INR<EagerFlags>(CPU* const cpu, uint8_t &reg);
+template void INR<LazyFlags>(CPU* const cpu, uint8_t &reg);
+template void DCR<EagerFlags>(CPU* const cpu, uint8_t &reg);
+template void DCR<LazyFlags>(CPU* const cpu, uint8_t &reg);
+template void ANA<EagerFlags>(CPU* const cpu, uint8_t const address);
+template void ANA<LazyFlags>(CPU* const cpu, uint8_t const address);
+template void XRA<EagerFlags>(CPU* const cpu, uint8_t const address);
+template void XRA<LazyFlags>(CPU* const cpu, uint8_t const address);
+template void ORA<EagerFlags>(CPU* const cpu, uint8_t const address);
+template void ORA<LazyFlags>(CPU* const cpu, uint8_t const address);
+template void CMP<EagerFlags>(CPU* const cpu, uint8_t const address);
+template void CMP<LazyFlags>(CPU* const cpu, uint8_t const address);
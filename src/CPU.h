@@ -0,0 +1,310 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+double const TIC =  (1000.0 / 60.0);  // Milliseconds per tic 60FPS
+double const CYCLES_PER_MS = 2000;  // 8080 runs at 2 MHz
+double const CYCLES_PER_TIC = (CYCLES_PER_MS * TIC);
+
+struct ConditionCodes {
+	uint8_t z : 1; // Z (zero) set to 1 when the result is equal to zero
+	uint8_t s : 1; // S (sign) set to 1 when bit 7 (the most significant bit or MSB) of the math instruction is set
+	uint8_t p : 1; // P (parity) is set when the answer has even parity, clear when odd parity
+	uint8_t cy : 1; // CY (carry) set to 1 when the instruction resulted in a carry out or borrow into the high order bit
+	uint8_t ac : 1; // AC (auxillary carry) is used for BCD (binary coded decimal) math, not needed for space invaders
+	uint8_t pad : 3; // Not sure
+};
+
+// Z, S, P and AC of the last ALU op when they have not been written to
+// ConditionCodes yet, see LazyFlags in Flags.h
+struct PendingFlags {
+	uint8_t kind; // FLAGS_NONE when ConditionCodes is up to date
+	uint8_t a;
+	uint8_t val;
+	uint8_t res;
+};
+
+// Space Invaders' external shift hardware, on ports 2 to 4 (see Ports.h)
+struct ShiftRegister {
+	uint16_t value; // last two bytes written, the newest on top
+	uint8_t offset; // bits to shift the result by
+};
+
+// Branch hint for the hot paths, a no-op where the compiler has none
+#ifdef __GNUC__
+#define I8080_LIKELY(x) __builtin_expect(!!(x), 1)
+#else
+#define I8080_LIKELY(x) (x)
+#endif
+
+struct BlockCache;
+struct Jit;
+struct BusHooks;
+struct PortMap;
+struct TraceRing;
+struct OpCounts;
+struct Profile;
+
+struct CPU {
+	uint8_t a;
+	uint8_t b;
+	uint8_t c;
+	uint8_t d; // Registry Locations
+	uint8_t e;
+	uint8_t h;
+	uint8_t l;
+	uint16_t sp; // Stack Pointer
+	uint16_t pc; // Program Counter
+	uint8_t* memory; // Memory Buffer
+	ConditionCodes cc;
+	PendingFlags pending;
+	uint8_t ports[9] = { 0,0,0,0,0,0,0,0,0 };
+	uint8_t int_enable; // interrupt
+	ShiftRegister shift;
+	BlockCache* blocks; // predecoded code, NULL unless the block engine is used
+	Jit* jit; // native code, NULL unless the JIT is on
+	uint32_t code_pages[8]; // one bit per 256 byte page of memory holding predecoded code
+	BusHooks* hooks; // store hooks, NULL until a page gets one
+	PortMap const* io; // devices behind IN and OUT, see Ports.h
+	TraceRing* trace; // binary trace for RingTrace, NULL unless traced (see Trace.h)
+	OpCounts* counts; // per-opcode counts for CountTrace, NULL unless counted (see OpCounts.h)
+	Profile* profile; // coverage for CoverTrace, NULL unless profiled (see Profiler.h)
+
+	// Memory bus, see Bus.h. Every load and store goes through these tables
+	// of 256 byte pages, so ROM, RAM, mirrors and unmapped space differ only
+	// in where the pointers point.
+	uint8_t* read_page[256];
+	uint8_t* write_page[256]; // NULL when stores to the page need CPU_write_slow
+	uint8_t* write_target[256]; // where stores to each page end up
+	uint8_t bus_sink[256]; // stores to ROM and unmapped pages
+};
+
+extern unsigned char cycles8080[];  // conditional calls and returns at their taken count
+extern unsigned char lengths8080[];
+
+// Cycles of a conditional call or return that falls through
+int const CYCLES_CALL_SKIPPED = 11;
+int const CYCLES_RET_SKIPPED = 5;
+
+// Trace policies //
+
+// The interpreter is instantiated once per trace policy, so whatever a policy
+// does is decided at compile time. NoTrace compiles away completely; PrintTrace
+// is the per-instruction disassembly and register dump used for debugging;
+// RingTrace (Trace.h) records the same in binary, fast enough for long runs;
+// CountTrace (OpCounts.h) counts executions and cycles per opcode; CoverTrace
+// (Profiler.h) marks the addresses instructions run from.
+
+struct NoTrace {
+	static void instruction(CPU*) {}
+	static void registers(CPU*, int) {}
+	static void cycles(int) {}
+};
+
+struct PrintTrace {
+	static void instruction(CPU* const cpu);
+	static void registers(CPU* const cpu, int const cycles);
+	static void cycles(int const i);
+};
+
+// Build with I8080_TRACE defined to get the debug output in the emulator.
+#ifdef I8080_TRACE
+typedef PrintTrace DefaultTrace;
+#else
+typedef NoTrace DefaultTrace;
+#endif
+
+// Flag policies, defined in Flags.h. EagerFlags writes every flag as it is
+// produced; LazyFlags defers Z, S, P and AC until something reads them.
+struct EagerFlags;
+struct LazyFlags;
+
+/*
+	EFFECTS : returns a new CPU with zeroed memory mapped flat, or NULL
+			  after printing an error when the host has no memory for it
+*/
+
+CPU* CPU_INIT();
+
+/*
+	REQUIRES: cpu came from CPU_INIT or CPU_clone, its engine caches are freed
+	EFFECTS : frees cpu and its memory
+*/
+
+void CPU_free(CPU* cpu);
+
+/*
+	REQUIRES: *cpu is a valid pointer to a CPU data type
+	EFFECTS : returns a new CPU with the same registers, flags and memory,
+			  or NULL after printing an error when the host has no memory
+			  for it
+*/
+
+CPU* CPU_clone(CPU const* cpu);
+
+/*
+	Modifies: cc
+	EFFECTS : writes any flags LazyFlags deferred to cc
+*/
+
+void CPU_sync_flags(CPU* const cpu);
+
+/*
+	EFFECTS : drops predecoded code fetched from the page of memory a store
+			  to address lands in, through any address that reads it.
+			  Called by CPU_write_slow when it stores into such a page.
+*/
+
+void CPU_code_written(CPU* const cpu, uint16_t const address);
+
+/*
+	Modifies: code_pages, write_page
+	EFFECTS : marks the page of memory that page reads from as holding
+			  predecoded code or not. Stores to it, through any mirror,
+			  take CPU_write_slow.
+*/
+
+void CPU_set_code_page(CPU* const cpu, int const page, bool const on);
+
+/*
+	EFFECTS : stores val at address on a page with code or a hook, then
+			  drops the code and calls the hook
+*/
+
+void CPU_write_slow(CPU* const cpu, uint16_t const address, uint8_t const val);
+
+// Page of cpu->memory that p points into, -1 when p points elsewhere (the
+// store sink, open bus)
+inline int CPU_memory_page(CPU const* const cpu, uint8_t const* const p) {
+	ptrdiff_t const offset = p - cpu->memory;
+	return offset >= 0 && offset < 0x10000 ? (int) (offset >> 8) : -1;
+}
+
+// Whether code fetched from page is predecoded somewhere. Code is tracked by
+// the page of memory it comes from, so every mirror of that page sees it.
+inline bool CPU_has_code(CPU const* const cpu, int const page) {
+	int const source = CPU_memory_page(cpu, cpu->read_page[page]);
+	return source >= 0 && ((cpu->code_pages[source >> 5] >> (source & 31)) & 1);
+}
+
+// Load path, every instruction that reads memory goes through here
+inline uint8_t CPU_read(CPU const* const cpu, uint16_t const address) {
+	return cpu->read_page[address >> 8][address & 0xff];
+}
+
+// Store path, every instruction that writes memory goes through here
+inline void CPU_write(CPU* const cpu, uint16_t const address, uint8_t const val) {
+	uint8_t* const page = cpu->write_page[address >> 8];
+	if (page != NULL) {
+		page[address & 0xff] = val;
+	}
+	else {
+		CPU_write_slow(cpu, address, val);
+	}
+}
+
+/*
+	EFFECTS : copies the instruction at pc to scratch and returns scratch,
+			  for instructions in the last two bytes of a page
+*/
+
+uint8_t* CPU_fetch_straddling(CPU* const cpu, uint8_t* const scratch);
+
+/*
+	EFFECTS : returns the bytes of the instruction at pc. Pages next to
+			  each other in the address space needn't be next to each other
+			  in memory, so an instruction in the last two bytes of a page
+			  is copied out to scratch first.
+*/
+
+inline uint8_t* CPU_fetch(CPU* const cpu, uint8_t* const scratch) {
+	uint16_t const pc = cpu->pc;
+	if (I8080_LIKELY((pc & 0xff) < 0xfe)) {
+		return &cpu->read_page[pc >> 8][pc & 0xff];
+	}
+	return CPU_fetch_straddling(cpu, scratch);
+}
+
+// Intel 8080 CPU Instructions, shared by every interpreter core //
+
+// Data Transfer
+void MOV(uint8_t &dst, uint8_t const src);
+
+// Arithmetic
+template <typename Flags = EagerFlags> void ADD(CPU* const cpu, uint8_t const a, uint8_t const val, bool const cy);
+template <typename Flags = EagerFlags> void SUB(CPU* const cpu, uint8_t const a, uint8_t const val, bool const cy);
+template <typename Flags = EagerFlags> void DAA(CPU* cpu);
+void CPU_set_bc(CPU* const cpu, uint16_t const val);
+void CPU_set_de(CPU* const cpu, uint16_t const val);
+void CPU_set_hl(CPU* const cpu, uint16_t const val);
+uint16_t CPU_get_bc(CPU* const cpu);
+uint16_t CPU_get_de(CPU* const cpu);
+uint16_t CPU_get_hl(CPU* const cpu);
+void DAD(CPU* const cpu, uint16_t const val);
+template <typename Flags = EagerFlags> void INR(CPU* const cpu, uint8_t &reg);
+template <typename Flags = EagerFlags> void DCR(CPU* const cpu, uint8_t &reg);
+
+// Logical
+void CMA(CPU* const cpu);
+void STC(CPU* const cpu);
+void CMC(CPU* const cpu);
+void RLC(CPU* const cpu);
+void RRC(CPU* const cpu);
+void RAL(CPU* const cpu);
+void RAR(CPU* const cpu);
+template <typename Flags = EagerFlags> void ANA(CPU* const cpu, uint8_t const address);
+template <typename Flags = EagerFlags> void XRA(CPU* const cpu, uint8_t const address);
+template <typename Flags = EagerFlags> void ORA(CPU* const cpu, uint8_t const address);
+template <typename Flags = EagerFlags> void CMP(CPU* const cpu, uint8_t const address);
+
+// Branch
+void JMP(CPU* const cpu, uint16_t const address);
+void JMP_COND(CPU* const cpu, uint16_t const address, bool const condition);
+void CALL(CPU* const cpu, uint16_t const address);
+bool CALL_COND(CPU* const cpu, uint16_t const address, bool const condition); // returns whether it called
+void RET(CPU* const cpu);
+bool RET_COND(CPU* const cpu, bool const condition); // returns whether it returned
+
+// Stack
+void PUSH(CPU* cpu, std::string registry);
+void POP(CPU* cpu, std::string registry);
+
+// I/O
+void IN(CPU* const cpu, uint8_t const port);
+void OUT(CPU* const cpu, uint8_t const port);
+
+// Special
+void EI(CPU* const cpu);
+void DI(CPU* const cpu);
+void NOP(CPU* const cpu);
+void UnimplementedInstruction(CPU* const cpu);
+
+/*
+	REQUIRES: *cpu is a valid pointer to a CPU data type
+	Modifies: pc
+	EFFECTS : Runs instructions with their respective opcodes from CPU::memory,
+			  returns the number of cycles the instruction took
+*/
+
+template <typename Trace, typename Flags = EagerFlags>
+int EmulateI8080_op(CPU* const cpu);
+
+/*
+	REQUIRES: *cpu is a valid pointer to a CPU data type
+	EFFECTS : Runs instructions until at least cycles cycles have passed,
+			  returns the cycles that did pass
+*/
+
+template <typename Trace, typename Flags = EagerFlags>
+int cpu_run(CPU* cpu, double cycles);
+
+/*
+	Modifies: memory
+	EFFECTS : loads the file at filename from address 0, up to 64K of it.
+			  Returns false after printing an error if it can't be read.
+*/
+
+bool ReadFileIntoMemoryAt(CPU* cpu, std::string filename);
+
+void generate_interrupt(CPU* cpu, int interrupt_num);
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdio>
+
+/*
+	EFFECTS : opens path with an fopen mode, returns NULL if it can't.
+			  fopen_s on Visual C++, which deprecates fopen, and fopen
+			  everywhere else, where fopen_s usually doesn't exist.
+*/
+
+inline FILE* file_open(char const* path, char const* mode) {
+#ifdef _MSC_VER
+	FILE* f = NULL;
+	fopen_s(&f, path, mode);
+	return f;
+#else
+	return fopen(path, mode);
+#endif
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <cstdint>
+#include "CPU.h"
+
+// Flag lookup tables for the ALU helpers, generated at compile time.
+
+// Flag bits, in the order PUSH PSW packs them
+uint8_t const FLAG_Z = 0x01;
+uint8_t const FLAG_S = 0x02;
+uint8_t const FLAG_P = 0x04;
+uint8_t const FLAG_CY = 0x08;
+uint8_t const FLAG_AC = 0x10;
+
+// Z, S and P of every possible result byte
+struct ZSPTable {
+	uint8_t flags[256];
+
+	constexpr ZSPTable() : flags() {
+		for (int x = 0; x < 256; x++) {
+			int bits = 0;
+			for (int i = 0; i < 8; i++) {
+				bits += (x >> i) & 1;
+			}
+
+			flags[x] = (x == 0 ? FLAG_Z : 0) |
+				((x & 0x80) ? FLAG_S : 0) |
+				((bits % 2) ? 0 : FLAG_P);  // even parity
+		}
+	}
+
+	constexpr uint8_t operator[](uint8_t const x) const {
+		return flags[x];
+	}
+};
+
+// Carry and aux carry only depend on one bit of each operand and of the
+// result: bit 7 for CY and bit 3 for AC. carry_index packs those bits so the
+// low 3 bits index the AC tables and the high 3 bits the CY tables.
+inline uint8_t carry_index(uint8_t const a, uint8_t const val, uint8_t const res) {
+	return ((a & 0x88) >> 1) | ((val & 0x88) >> 2) | ((res & 0x88) >> 3);
+}
+
+// Carry (or borrow, when sub is set) out of a bit, indexed by that bit of
+// a, val and the result as abr. The 8080 subtracts by adding the complement,
+// so AC after a subtraction is the inverted borrow.
+struct CarryTable {
+	uint8_t flags[8];
+
+	constexpr CarryTable(bool const sub, bool const inverted) : flags() {
+		for (int i = 0; i < 8; i++) {
+			int const a = (i >> 2) & 1;
+			int const val = (i >> 1) & 1;
+			int const res = i & 1;
+			int const in = a ^ val ^ res;  // carry or borrow into the bit
+
+			int const out = sub ?
+				(((a ^ 1) & val) | ((a ^ 1) & in) | (val & in)) :
+				((a & val) | (a & in) | (val & in));
+
+			flags[i] = (uint8_t) (out ^ inverted);
+		}
+	}
+
+	constexpr uint8_t operator[](uint8_t const idx) const {
+		return flags[idx];
+	}
+};
+
+constexpr ZSPTable ZSP = ZSPTable();
+constexpr CarryTable CY_ADD = CarryTable(false, false);
+constexpr CarryTable AC_ADD = CarryTable(false, false);
+constexpr CarryTable CY_SUB = CarryTable(true, false);
+constexpr CarryTable AC_SUB = CarryTable(true, true);
+
+// Flag policies //
+
+// What produced the pending flags, which decides how AC is derived
+enum FlagsKind : uint8_t {
+	FLAGS_NONE,  // nothing pending
+	FLAGS_ADD,
+	FLAGS_SUB,
+	FLAGS_ANA,
+	FLAGS_LOGIC, // XRA and ORA, AC is cleared
+};
+
+// Sets Z, S and P from the result byte
+inline void set_zsp(ConditionCodes* const cc, uint8_t const res) {
+	uint8_t const flags = ZSP[res];
+	cc->z = (flags & FLAG_Z) != 0;
+	cc->s = (flags & FLAG_S) != 0;
+	cc->p = (flags & FLAG_P) != 0;
+}
+
+// Sets Z, S, P and AC for an ALU op of the given kind
+inline void set_zspac(ConditionCodes* const cc, uint8_t const kind, uint8_t const a, uint8_t const val, uint8_t const res) {
+	set_zsp(cc, res);
+
+	switch (kind)
+	{
+	case FLAGS_ADD: cc->ac = AC_ADD[carry_index(a, val, res) & 7]; break;
+	case FLAGS_SUB: cc->ac = AC_SUB[carry_index(a, val, res) & 7]; break;
+	case FLAGS_ANA: cc->ac = ((a | val) & 0x08) != 0; break; // 8080 ANA quirk
+	case FLAGS_LOGIC: cc->ac = 0; break;
+	}
+}
+
+// The ALU helpers always set CY themselves, it is a single table lookup and
+// rotates, DAD and the carry branches read it all the time. Z, S, P and AC go
+// through the policy's result().
+
+struct EagerFlags {
+	static void result(CPU* const cpu, uint8_t const kind, uint8_t const a, uint8_t const val, uint8_t const res) {
+		set_zspac(&cpu->cc, kind, a, val, res);
+	}
+
+	static void sync(CPU*) {}
+};
+
+// Only records the operands. Everything that reads Z, S, P or AC (the
+// conditional branches, PUSH PSW, DAA and the trace) calls sync() first.
+// POP PSW overwrites all flags, so it drops whatever is pending.
+struct LazyFlags {
+	static void result(CPU* const cpu, uint8_t const kind, uint8_t const a, uint8_t const val, uint8_t const res) {
+		cpu->pending.kind = kind;
+		cpu->pending.a = a;
+		cpu->pending.val = val;
+		cpu->pending.res = res;
+	}
+
+	static void sync(CPU* const cpu) {
+		if (cpu->pending.kind != FLAGS_NONE) {
+			set_zspac(&cpu->cc, cpu->pending.kind, cpu->pending.a, cpu->pending.val, cpu->pending.res);
+			cpu->pending.kind = FLAGS_NONE;
+		}
+	}
+};
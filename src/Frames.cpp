@@ -0,0 +1,32 @@
+#include <cstring>
+#include "Frames.h"
+
+void frame_exchange_init(FrameExchange* frames) {
+	memset(frames->slots, 0, sizeof(frames->slots));
+	frames->middle.store(1);
+	frames->back = 0;
+	frames->front = 2;
+	frames->published = 0;
+}
+
+void frame_exchange_publish(FrameExchange* frames, uint8_t const* vram, VideoDirty* dirty) {
+	VideoFrame* frame = &frames->slots[frames->back];
+	memcpy(frame->vram, vram, VRAM_SIZE);
+	frame->number = frames->published++;
+	frame->dirty = *dirty;
+	video_dirty_clear(dirty);
+
+	// Release: the reader sees the whole frame once it sees the index
+	uint8_t const old = frames->middle.exchange(frames->back | FRAME_FRESH, std::memory_order_acq_rel);
+	frames->back = old & 3;
+}
+
+VideoFrame const* frame_exchange_take(FrameExchange* frames) {
+	if (!(frames->middle.load(std::memory_order_relaxed) & FRAME_FRESH)) {
+		return NULL;
+	}
+
+	uint8_t const old = frames->middle.exchange(frames->front, std::memory_order_acq_rel);
+	frames->front = old & 3;
+	return &frames->slots[frames->front];
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include "Video.h"
+
+// Frames handed from the emulation thread to the render thread without
+// locks. Three slots: the writer fills its own, publishing swaps it with the
+// shared middle one, and the reader swaps the middle one for its own when
+// it holds something new. Neither side ever waits, the reader just gets the
+// newest frame and frames it was too slow for are dropped.
+
+struct VideoFrame {
+	uint8_t vram[VRAM_SIZE];
+	uint64_t number; // frames published before this one
+	VideoDirty dirty; // columns stored to since the frame before it
+};
+
+struct FrameExchange {
+	VideoFrame slots[3];
+	std::atomic<uint8_t> middle; // slot index, FRAME_FRESH when not read yet
+	uint8_t back; // the writer's slot
+	uint8_t front; // the reader's slot
+	uint64_t published;
+};
+
+uint8_t const FRAME_FRESH = 4;
+
+/*
+	Modifies: *frames
+	EFFECTS : empties frames, nothing is published
+*/
+
+void frame_exchange_init(FrameExchange* frames);
+
+/*
+	REQUIRES: only the writing thread calls this
+	Modifies: *frames, *dirty
+	EFFECTS : publishes a copy of vram (VRAM_SIZE bytes) with the columns
+			  marked in dirty, then clears dirty
+*/
+
+void frame_exchange_publish(FrameExchange* frames, uint8_t const* vram, VideoDirty* dirty);
+
+/*
+	REQUIRES: only the reading thread calls this
+	Modifies: *frames
+	EFFECTS : returns the newest frame published since the last call, or
+			  NULL if there is none. It stays valid until the next call.
+*/
+
+VideoFrame const* frame_exchange_take(FrameExchange* frames);
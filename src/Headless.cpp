@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "Headless.h"
+#include "Files.h"
+
+bool input_script_load(InputScript* script, char const* path) {
+	script->steps.clear();
+	script->next = 0;
+
+	FILE* f = file_open(path, "r");
+	if (f == NULL) {
+		printf("error: Couldn't open %s\n", path);
+		return false;
+	}
+
+	char line[256];
+	int number = 0;
+	bool ok = true;
+	while (ok && fgets(line, sizeof(line), f) != NULL) {
+		number++;
+		char* p = line;
+		while (*p == ' ' || *p == '\t') {
+			p++;
+		}
+		if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0') {
+			continue;
+		}
+
+		char* end;
+		unsigned long long frame = strtoull(p, &end, 0);
+		bool parsed = end != p;
+		p = end;
+		long port = strtol(p, &end, 0);
+		parsed = parsed && end != p;
+		p = end;
+		long val = strtol(p, &end, 0);
+		parsed = parsed && end != p;
+
+		// Only IN reads ports, and the cabinet's controls are on 0 to 2
+		if (!parsed || port < 0 || port > 2 || val < 0 || val > 0xff) {
+			printf("error: %s:%d: expected \"frame port value\"\n", path, number);
+			ok = false;
+			break;
+		}
+
+		InputStep step;
+		step.frame = frame;
+		step.port = (uint8_t) port;
+		step.val = (uint8_t) val;
+		script->steps.push_back(step);
+	}
+	fclose(f);
+
+	// Steps of the same frame keep their order in the file
+	std::stable_sort(script->steps.begin(), script->steps.end(),
+		[](InputStep const& x, InputStep const& y) { return x.frame < y.frame; });
+	return ok;
+}
+
+void input_script_apply(InputScript* script, uint64_t frame, uint8_t* ports) {
+	while (script->next < script->steps.size() && script->steps[script->next].frame <= frame) {
+		InputStep const& step = script->steps[script->next];
+		ports[step.port] = step.val;
+		script->next++;
+	}
+}
+
+static void scripted_input(Machine* machine) {
+	input_script_apply((InputScript*) machine->hooks.user, machine->scheduler.frame, machine->cpu->ports);
+}
+
+void input_script_attach(InputScript* script, Machine* machine) {
+	machine->hooks.input = scripted_input;
+	machine->hooks.user = script;
+}
+
+bool dump_vram(CPU const* cpu, char const* path) {
+	FILE* f = file_open(path, "wb");
+	if (f == NULL) {
+		printf("error: Couldn't write %s\n", path);
+		return false;
+	}
+
+	bool ok = fwrite(cpu->memory + VRAM_START, 1, VRAM_SIZE, f) == VRAM_SIZE;
+	fclose(f);
+	return ok;
+}
+
+
+void run_headless(Machine* machine, int frames, InputScript* script, Pacer* pacer) {
+	machine->hooks.input = NULL;
+	machine->hooks.present = NULL;
+	machine->hooks.user = NULL;
+	if (script != NULL) {
+		input_script_attach(script, machine);
+	}
+
+	Scheduler const& scheduler = machine->scheduler;
+	uint64_t const first_frame = scheduler.frame;
+	uint64_t const first_cycle = scheduler.now;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	while (frames == 0 || scheduler.frame - first_frame < (uint64_t) frames) {
+		machine_run_frame(machine);
+		if (pacer != NULL) {
+			pacer_wait(pacer);
+		}
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	uint64_t const ran = scheduler.frame - first_frame;
+	if (seconds > 0) {
+		printf("%llu frames in %.3f s: %.1f frames/s, %.1f MHz\n", (unsigned long long) ran, seconds,
+			ran / seconds, (scheduler.now - first_cycle) / seconds / 1e6);
+	}
+	if (pacer != NULL) {
+		pacer_report(pacer);
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "CPU.h"
+#include "Machine.h"
+#include "Pacer.h"
+#include "Video.h"
+
+// Runs the machine without a window, for batch runs and throughput numbers.
+// Frames go by as fast as the host allows, the controls come from a script
+// instead of the keyboard, and nothing is drawn. Nothing here needs SDL, so
+// a build with I8080_HEADLESS defined leaves out display.cpp.
+
+struct InputStep {
+	uint64_t frame; // frame whose input sampling applies it
+	uint8_t port;
+	uint8_t val;
+};
+
+// Scripted controls, sorted by frame
+struct InputScript {
+	std::vector<InputStep> steps;
+	size_t next; // first step not applied yet
+};
+
+/*
+	Modifies: *script
+	EFFECTS : reads the script at path, one "frame port value" step per
+			  line, numbers in C syntax (so 0x10 works), # starts a comment.
+			  Returns false after printing the bad line when a line doesn't
+			  parse or names a port past the input ports.
+*/
+
+bool input_script_load(InputScript* script, char const* path);
+
+/*
+	Modifies: *script, ports
+	EFFECTS : writes every step due by frame into ports, in file order
+*/
+
+void input_script_apply(InputScript* script, uint64_t frame, uint8_t* ports);
+
+/*
+	Modifies: machine->hooks
+	EFFECTS : has machine take its controls from script at every frame
+*/
+
+void input_script_attach(InputScript* script, Machine* machine);
+
+/*
+	EFFECTS : writes the raw 1bpp video RAM, VRAM_START up to 0x4000, to
+			  path. Returns false if the file can't be written.
+*/
+
+bool dump_vram(CPU const* cpu, char const* path);
+
+/*
+	REQUIRES: *machine has a program in memory
+	Modifies: *machine, *script, *pacer
+	EFFECTS : runs frames frames (forever when 0), paced by pacer or as
+			  fast as possible if it is NULL, the controls taken from script
+			  if it isn't NULL. Replaces the machine's hooks. Prints the
+			  frames per second and the emulated clock rate when done, and
+			  the pacer's report.
+*/
+
+void run_headless(Machine* machine, int frames, InputScript* script, Pacer* pacer);
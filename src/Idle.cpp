@@ -0,0 +1,88 @@
+#include <cstring>
+#include "Idle.h"
+#include "Flags.h"
+
+// What a pass of a loop can change without storing
+struct LoopState {
+	uint8_t a, b, c, d, e, h, l;
+	uint8_t cc;
+	uint16_t sp, pc;
+	uint8_t int_enable;
+};
+
+static LoopState loop_state(CPU const* cpu) {
+	LoopState state;
+	state.a = cpu->a; state.b = cpu->b; state.c = cpu->c; state.d = cpu->d;
+	state.e = cpu->e; state.h = cpu->h; state.l = cpu->l;
+	memcpy(&state.cc, &cpu->cc, 1);
+	state.sp = cpu->sp;
+	state.pc = cpu->pc;
+	state.int_enable = cpu->int_enable;
+	return state;
+}
+
+static bool same_state(LoopState const& x, LoopState const& y) {
+	return x.a == y.a && x.b == y.b && x.c == y.c && x.d == y.d && x.e == y.e && x.h == y.h && x.l == y.l &&
+		x.cc == y.cc && x.sp == y.sp && x.pc == y.pc && x.int_enable == y.int_enable;
+}
+
+// Instructions that store or touch I/O, a loop running any of them is not idle
+static bool has_side_effects(uint8_t const op) {
+	switch (op)
+	{
+	case 0x32: case 0x36: case 0x77: // STA, MVI M, MOV M,A
+	case 0xc5: case 0xd5: case 0xe5: case 0xf5: case 0xcd: // PUSH, CALL
+	case 0xd3: case 0xdb: // OUT, IN
+		return true;
+	}
+
+	return false;
+}
+
+template <typename Flags>
+int cpu_run_skip_idle(CPU* cpu, double cycles) {
+	int i = 0;
+
+	// The last backward jump target, as the CPU was when it got there
+	LoopState head;
+	int head_cycles = -1; // i at the head, -1 while there is none
+	bool clean = false; // nothing stored or I/O since the head
+
+	while (i < cycles) {
+		uint16_t const pc = cpu->pc;
+		if (clean && has_side_effects(CPU_read(cpu, pc))) {
+			clean = false;
+		}
+
+		i += EmulateI8080_op<NoTrace, Flags>(cpu);
+
+		if (cpu->pc > pc) {
+			continue;
+		}
+
+		// Pending lazy flags are part of the state, have them in cc
+		Flags::sync(cpu);
+		LoopState const state = loop_state(cpu);
+
+		if (clean && head_cycles >= 0 && i > head_cycles && same_state(state, head)) {
+			// Skip whole passes while the interpreter would still start
+			// the one after them
+			int const pass = i - head_cycles;
+			int skip = (int) ((cycles - i) / pass);
+			if (i + skip * pass >= cycles) {
+				skip--;
+			}
+			if (skip > 0) {
+				i += skip * pass;
+			}
+		}
+
+		head = state;
+		head_cycles = i;
+		clean = true;
+	}
+	return i;
+}
+
+template int cpu_run_skip_idle<EagerFlags>(CPU* cpu, double cycles);
+template int cpu_run_skip_idle<LazyFlags>(CPU* cpu, double cycles);
@@ -0,0 +1,20 @@
+#pragma once
+#include "CPU.h"
+
+// Idle-loop fast-forward. A wait loop that polls a RAM flag set by an
+// interrupt handler comes back to its head with the same registers and flags
+// on every pass as long as nothing stores, and interrupts only happen between
+// cpu_run calls, so every further pass until the end of the slice is the same
+// as the one just seen. Those passes are skipped as a whole.
+
+/*
+	REQUIRES: *cpu is a valid pointer to a CPU data type
+	EFFECTS : Same as cpu_run<NoTrace, Flags>. When a backward jump comes
+			  back to the same pc with the same registers and flags, and
+			  nothing was stored and no IN or OUT ran since the last time,
+			  adds the cycles of as many more passes as fit in the slice
+			  without running them.
+*/
+
+template <typename Flags = EagerFlags>
+int cpu_run_skip_idle(CPU* cpu, double cycles);
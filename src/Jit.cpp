@@ -0,0 +1,679 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include "Jit.h"
+#include "Flags.h"
+#include "Verify.h"
+
+#ifdef I8080_JIT
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+int const MAX_JIT_OPS = 32;
+size_t const JIT_BUFFER_SIZE = 1 << 20;
+size_t const MAX_BLOCK_BYTES = 8192; // room a block may need, more than 32 ops can take
+uint8_t const JIT_HOT = 32; // interpreted runs of an address before it is compiled
+uint8_t const JIT_COLD = 255; // heat of addresses that can't start a block
+uint8_t const JIT_PAGE_WRITES = 8; // invalidations after which a page stays interpreted
+
+// Host registers of the 8080 registers, in the order opcodes encode them
+// (B, C, D, E, H, L, M, A). M has no register. rbx holds the CPU* and SP
+// lives in r15w; rax, rcx and rdx are scratch.
+static int const HOST[8] = { 9, 10, 11, 12, 13, 14, -1, 8 };
+int const HOST_A = 8, HOST_B = 9, HOST_C = 10, HOST_D = 11, HOST_E = 12, HOST_H = 13, HOST_L = 14;
+static size_t const REG_OFFSET[8] = { offsetof(CPU, b), offsetof(CPU, c), offsetof(CPU, d), offsetof(CPU, e),
+	offsetof(CPU, h), offsetof(CPU, l), 0, offsetof(CPU, a) };
+
+// Instructions the JIT translates, everything else ends the block and runs in
+// the interpreter. IN and OUT always do, and so do the unimplemented opcodes
+// and the conditional returns, whose cycles depend on the condition.
+enum JitKind {
+	JIT_NONE,
+	JIT_NATIVE, // translated to host code
+	JIT_STORE, // translated, stores through the bus like CPU_write
+	JIT_HELPER, // runs EmulateI8080_op from inside the block
+};
+
+static JitKind jit_kind(uint8_t const op) {
+	switch (op)
+	{
+	case 0x00: case 0x01: case 0x05: case 0x06: case 0x0d: case 0x0e:
+	case 0x11: case 0x13: case 0x1a:
+	case 0x21: case 0x23: case 0x26:
+	case 0x31: case 0x35: case 0x3a: case 0x3d: case 0x3e:
+	case 0x56: case 0x5e: case 0x66: case 0x6f:
+	case 0x7a: case 0x7b: case 0x7c: case 0x7d: case 0x7e:
+	case 0xc2: case 0xc3: case 0xca: case 0xd2: case 0xda:
+	case 0xeb:
+		return JIT_NATIVE;
+	case 0x32: case 0x36: case 0x77:
+		return JIT_STORE;
+	case 0x09: case 0x0f: case 0x19: case 0x27: case 0x29:
+	case 0xa7: case 0xaf:
+	case 0xc1: case 0xc5: case 0xc6: case 0xc9: case 0xcd:
+	case 0xd1: case 0xd5:
+	case 0xe1: case 0xe5: case 0xe6:
+	case 0xf1: case 0xf5: case 0xfb: case 0xfe:
+		return JIT_HELPER;
+	}
+
+	return JIT_NONE;
+}
+
+// Jumps, calls and returns end a block
+static bool ends_block(uint8_t const op) {
+	switch (op)
+	{
+	case 0xc2: case 0xc3: case 0xc9: case 0xca: case 0xcd:
+	case 0xd2: case 0xda:
+		return true;
+	}
+
+	return false;
+}
+
+// x86-64 code emitter //
+
+struct Emitter {
+	uint8_t* p;
+};
+
+static void emit(Emitter& e, uint8_t const byte) {
+	*e.p++ = byte;
+}
+
+static void emit(Emitter& e, std::initializer_list<uint8_t> const bytes) {
+	for (uint8_t byte : bytes) {
+		*e.p++ = byte;
+	}
+}
+
+static void emit32(Emitter& e, uint32_t const val) {
+	memcpy(e.p, &val, 4);
+	e.p += 4;
+}
+
+static void emit64(Emitter& e, uint64_t const val) {
+	memcpy(e.p, &val, 8);
+	e.p += 8;
+}
+
+static uint8_t disp(size_t const offset) {
+	return (uint8_t) offset;
+}
+
+// mov word [rbx+pc], val
+static void emit_set_pc(Emitter& e, uint16_t const val) {
+	emit(e, { 0x66, 0xc7, 0x43, disp(offsetof(CPU, pc)), (uint8_t) val, (uint8_t) (val >> 8) });
+}
+
+// Registers from the CPU into the host registers
+static void emit_load_registers(Emitter& e) {
+	for (int r = 0; r < 8; r++) {
+		if (HOST[r] >= 0) {
+			emit(e, { 0x44, 0x0f, 0xb6, (uint8_t) (0x43 | ((HOST[r] & 7) << 3)), disp(REG_OFFSET[r]) }); // movzx rNd, byte [rbx+reg]
+		}
+	}
+	emit(e, { 0x44, 0x0f, 0xb7, 0x7b, disp(offsetof(CPU, sp)) }); // movzx r15d, word [rbx+sp]
+}
+
+// Host registers back into the CPU
+static void emit_store_registers(Emitter& e) {
+	for (int r = 0; r < 8; r++) {
+		if (HOST[r] >= 0) {
+			emit(e, { 0x44, 0x88, (uint8_t) (0x43 | ((HOST[r] & 7) << 3)), disp(REG_OFFSET[r]) }); // mov [rbx+reg], rNb
+		}
+	}
+	emit(e, { 0x66, 0x44, 0x89, 0x7b, disp(offsetof(CPU, sp)) }); // mov [rbx+sp], r15w
+}
+
+static void emit_prologue(Emitter& e) {
+	emit(e, { 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57 }); // push rbx, r12-r15
+	emit(e, { 0x48, 0x83, 0xec, 0x20 }); // sub rsp, 32 (Win64 shadow space, keeps rsp aligned)
+#ifdef _WIN32
+	emit(e, { 0x48, 0x89, 0xcb }); // mov rbx, rcx
+#else
+	emit(e, { 0x48, 0x89, 0xfb }); // mov rbx, rdi
+#endif
+	emit_load_registers(e);
+}
+
+// Returns cycles | ops << 16
+static void emit_return(Emitter& e, int const cycles, int const ops) {
+	emit(e, 0xb8); // mov eax, imm32
+	emit32(e, (uint32_t) (cycles | (ops << 16)));
+	emit(e, { 0x48, 0x83, 0xc4, 0x20 }); // add rsp, 32
+	emit(e, { 0x41, 0x5f, 0x41, 0x5e, 0x41, 0x5d, 0x41, 0x5c, 0x5b, 0xc3 }); // pop r15-r12, rbx; ret
+}
+
+// Calls fn(cpu, ecx) with the registers already stored
+static void emit_call(Emitter& e, void const* fn) {
+#ifdef _WIN32
+	emit(e, { 0x89, 0xca }); // mov edx, ecx
+	emit(e, { 0x48, 0x89, 0xd9 }); // mov rcx, rbx
+#else
+	emit(e, { 0x89, 0xce }); // mov esi, ecx
+	emit(e, { 0x48, 0x89, 0xdf }); // mov rdi, rbx
+#endif
+	emit(e, { 0x48, 0xb8 }); // mov rax, imm64
+	emit64(e, (uint64_t) (uintptr_t) fn);
+	emit(e, { 0xff, 0xd0 }); // call rax
+}
+
+// Points the rel32 at at to the current position
+static void patch_rel32(Emitter& e, uint8_t* at) {
+	int32_t rel = (int32_t) (e.p - (at + 4));
+	memcpy(at, &rel, 4);
+}
+
+// After a call that returned written in eax: leave the block if it was set,
+// otherwise pick the registers back up
+static void emit_check_written(Emitter& e, int const cycles, int const ops) {
+	emit(e, { 0x85, 0xc0 }); // test eax, eax
+	emit(e, { 0x0f, 0x84 }); // jz rel32
+	uint8_t* skip = e.p;
+	emit32(e, 0);
+	emit_return(e, cycles, ops);
+	patch_rel32(e, skip);
+	emit_load_registers(e);
+}
+
+// ecx = (hi << 8) | lo, for HL and DE
+static void emit_pair_address(Emitter& e, int const hi, int const lo) {
+	emit(e, { 0x41, 0x0f, 0xb6, (uint8_t) (0xc8 | (hi & 7)) }); // movzx ecx, hi
+	emit(e, { 0xc1, 0xe1, 0x08 }); // shl ecx, 8
+	emit(e, { 0x41, 0x0f, 0xb6, (uint8_t) (0xd0 | (lo & 7)) }); // movzx edx, lo
+	emit(e, { 0x09, 0xd1 }); // or ecx, edx
+}
+
+// rax = table[ecx >> 8], one of the page tables of the bus, and edx = ecx >> 8
+static void emit_page(Emitter& e, size_t const table) {
+	emit(e, { 0x89, 0xca, 0xc1, 0xea, 0x08 }); // edx = ecx >> 8
+	emit(e, { 0x48, 0x8b, 0x84, 0xd3 }); // mov rax, [rbx+rdx*8+table]
+	emit32(e, (uint32_t) table);
+}
+
+// dst = the byte at ecx, read like CPU_read
+static void emit_load(Emitter& e, int const dst) {
+	emit_page(e, offsetof(CPU, read_page));
+	emit(e, { 0x0f, 0xb6, 0xc9 }); // movzx ecx, cl
+	emit(e, { 0x44, 0x8a, (uint8_t) (0x04 | ((dst & 7) << 3)), 0x08 }); // mov dst, [rax+rcx]
+}
+
+static void emit_mov_imm(Emitter& e, int const dst, uint8_t const val) {
+	emit(e, { 0x41, (uint8_t) (0xb0 | (dst & 7)), val }); // mov dst, imm8
+}
+
+/*
+	EFFECTS : DCR r, with the flags taken from the host's dec. Z, S and P
+			  line up with x86 ZF, SF and PF, and AC is the inverted AF like
+			  AC_SUB. CY is left alone, as on the 8080.
+*/
+
+static void emit_dcr(Emitter& e, int const reg) {
+	emit(e, { 0x41, 0xfe, (uint8_t) (0xc8 | (reg & 7)) }); // dec reg
+	emit(e, { 0x9c, 0x58 }); // pushfq; pop rax
+	emit(e, { 0x89, 0xc1, 0xc1, 0xe9, 0x06, 0x83, 0xe1, 0x03 }); // ecx = (ZF | SF << 1)
+	emit(e, { 0x89, 0xc2, 0x83, 0xe2, 0x04, 0x09, 0xd1 }); // ecx |= PF
+	emit(e, { 0xf7, 0xd0, 0x83, 0xe0, 0x10, 0x09, 0xc1 }); // ecx |= !AF << 4
+	emit(e, { 0x0f, 0xb6, 0x43, disp(offsetof(CPU, cc)) }); // movzx eax, byte [rbx+cc]
+	emit(e, 0x25); // and eax, ~(Z | S | P | AC)
+	emit32(e, 0xff & ~(FLAG_Z | FLAG_S | FLAG_P | FLAG_AC));
+	emit(e, { 0x09, 0xc8 }); // or eax, ecx
+	emit(e, { 0x88, 0x43, disp(offsetof(CPU, cc)) }); // mov [rbx+cc], al
+}
+
+// Conditional jump, pc is left on the next instruction unless the flag test
+// says otherwise. jump_if_set picks which state of mask takes the jump.
+static void emit_jump_cond(Emitter& e, uint16_t const next, uint16_t const target, uint8_t const mask, bool const jump_if_set) {
+	emit_set_pc(e, next);
+	emit(e, { 0xf6, 0x43, disp(offsetof(CPU, cc)), mask }); // test byte [rbx+cc], mask
+	emit(e, { (uint8_t) (jump_if_set ? 0x74 : 0x75), 0x06 }); // skip the store below
+	emit_set_pc(e, target);
+}
+
+// Called from native code //
+
+static int jit_run_op(CPU* cpu) {
+	cpu->jit->written = 0;
+	EmulateI8080_op<NoTrace, EagerFlags>(cpu);
+	return cpu->jit->written;
+}
+
+// Takes address | val << 16
+static int jit_write_slow(CPU* cpu, uint32_t const address_val) {
+	cpu->jit->written = 0;
+	CPU_write_slow(cpu, (uint16_t) address_val, (uint8_t) (address_val >> 16));
+	return cpu->jit->written;
+}
+
+/*
+	EFFECTS : stores val (a host register, or imm when val < 0) at ecx like
+			  CPU_write. Pages without a write pointer go through
+			  CPU_write_slow, and when that drops any blocks this one leaves
+			  right after the store, since it may be one of them.
+*/
+
+static void emit_store(Emitter& e, int const val, uint8_t const imm, uint16_t const next, int const cycles, int const ops) {
+	emit_page(e, offsetof(CPU, write_page));
+	emit(e, { 0x48, 0x85, 0xc0 }); // test rax, rax
+	emit(e, { 0x0f, 0x84 }); // jz slow
+	uint8_t* slow = e.p;
+	emit32(e, 0);
+
+	emit(e, { 0x0f, 0xb6, 0xd1 }); // movzx edx, cl
+	if (val >= 0) {
+		emit(e, { 0x44, 0x88, (uint8_t) (0x04 | ((val & 7) << 3)), 0x10 }); // mov [rax+rdx], val
+	}
+	else {
+		emit(e, { 0xc6, 0x04, 0x10, imm }); // mov byte [rax+rdx], imm8
+	}
+	emit(e, 0xe9); // jmp done
+	uint8_t* done = e.p;
+	emit32(e, 0);
+
+	patch_rel32(e, slow);
+	if (val >= 0) {
+		emit(e, { 0x41, 0x0f, 0xb6, (uint8_t) (0xc0 | (val & 7)) }); // movzx eax, val
+		emit(e, { 0xc1, 0xe0, 0x10, 0x09, 0xc1 }); // shl eax, 16; or ecx, eax
+	}
+	else {
+		emit(e, { 0x81, 0xc9 }); // or ecx, imm << 16
+		emit32(e, (uint32_t) imm << 16);
+	}
+	emit_store_registers(e);
+	emit_set_pc(e, next);
+	emit_call(e, (void const*) jit_write_slow);
+	emit_check_written(e, cycles, ops);
+
+	patch_rel32(e, done);
+}
+
+// Block cache //
+
+static void set_writable(Jit* jit, bool const writable) {
+#ifdef _WIN32
+	DWORD old;
+	VirtualProtect(jit->buffer, jit->size, writable ? PAGE_READWRITE : PAGE_EXECUTE_READ, &old);
+#else
+	mprotect(jit->buffer, jit->size, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC);
+#endif
+}
+
+bool jit_available() {
+	// The native DCR and the conditional jumps read ConditionCodes as a byte
+	ConditionCodes cc;
+	memset(&cc, 0, sizeof(cc));
+	cc.z = 1;
+	cc.cy = 1;
+	cc.ac = 1;
+	uint8_t bits;
+	memcpy(&bits, &cc, 1);
+
+	return bits == (FLAG_Z | FLAG_CY | FLAG_AC);
+}
+
+void jit_init(CPU* cpu) {
+	Jit* jit = new Jit();
+	jit->size = JIT_BUFFER_SIZE;
+#ifdef _WIN32
+	jit->buffer = (uint8_t*) VirtualAlloc(NULL, jit->size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+	jit->buffer = (uint8_t*) mmap(NULL, jit->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#endif
+	jit->used = 0;
+	memset(jit->by_pc, 0, sizeof(jit->by_pc));
+	memset(jit->heat, 0, sizeof(jit->heat));
+	memset(jit->page_writes, 0, sizeof(jit->page_writes));
+	jit->written = 0;
+	jit->compiled = 0;
+	jit->invalidated = 0;
+	set_writable(jit, false);
+	cpu->jit = jit;
+}
+
+// Drops the blocks with code on page
+static void drop_page(CPU* cpu, int const page) {
+	Jit* jit = cpu->jit;
+
+	// Native code stays in the buffer until it is flushed, so a block that
+	// is running when its own code is written can still return safely
+	for (JitBlock* block : jit->on_page[page]) {
+		jit->by_pc[block->start >> 8][block->start & 0xff] = NULL;
+
+		for (int other = block->start >> 8; other <= (block->end - 1) >> 8; other++) {
+			if (other != page) {
+				std::vector<JitBlock*>& list = jit->on_page[other];
+				list.erase(std::remove(list.begin(), list.end(), block), list.end());
+			}
+		}
+
+		delete block;
+	}
+
+	jit->on_page[page].clear();
+	CPU_set_code_page(cpu, page, false);
+}
+
+void jit_invalidate(CPU* cpu, uint8_t const page) {
+	Jit* jit = cpu->jit;
+	if (jit == NULL || jit->on_page[page].empty()) {
+		return;
+	}
+
+	jit->invalidated += jit->on_page[page].size();
+	drop_page(cpu, page);
+	jit->written = 1;
+	if (jit->page_writes[page] < JIT_PAGE_WRITES) {
+		jit->page_writes[page]++;
+	}
+}
+
+void jit_free(CPU* cpu) {
+	Jit* jit = cpu->jit;
+	if (jit == NULL) {
+		return;
+	}
+
+	for (int page = 0; page < 256; page++) {
+		drop_page(cpu, page);
+		delete[] jit->by_pc[page];
+	}
+#ifdef _WIN32
+	VirtualFree(jit->buffer, 0, MEM_RELEASE);
+#else
+	munmap(jit->buffer, jit->size);
+#endif
+
+	delete jit;
+	cpu->jit = NULL;
+}
+
+/*
+	REQUIRES: no native code is running
+	EFFECTS : translates the block starting at pc, returns NULL when the
+			  first instruction there can't be translated
+*/
+
+static JitBlock* compile(CPU* cpu, uint16_t const pc) {
+	Jit* jit = cpu->jit;
+
+	if (jit->used + MAX_BLOCK_BYTES > jit->size) {
+		// Buffer full, start over
+		for (int page = 0; page < 256; page++) {
+			drop_page(cpu, page);
+		}
+		jit->used = 0;
+	}
+
+	set_writable(jit, true);
+	Emitter e;
+	e.p = jit->buffer + jit->used;
+	uint8_t* const entry = e.p;
+	emit_prologue(e);
+
+	int address = pc;
+	int ops = 0;
+	int cycles = 0;
+	int lead_cycles = 0;
+	bool ended = false;
+	while (ops < MAX_JIT_OPS) {
+		uint8_t const op = CPU_read(cpu, address);
+		int const length = lengths8080[op];
+		JitKind const kind = jit_kind(op);
+		if (kind == JIT_NONE || address + length > 0x10000 ||
+			jit->page_writes[address >> 8] >= JIT_PAGE_WRITES ||
+			jit->page_writes[(address + length - 1) >> 8] >= JIT_PAGE_WRITES) {
+			break;
+		}
+
+		uint8_t const lo = length > 1 ? CPU_read(cpu, address + 1) : 0;
+		uint8_t const hi = length > 2 ? CPU_read(cpu, address + 2) : 0;
+		uint16_t const imm = (hi << 8) | lo;
+		uint16_t const next = address + length;
+
+		lead_cycles = cycles;
+		cycles += cycles8080[op];
+		ops++;
+
+		switch (op)
+		{
+		case 0x00: break; // NOP
+		case 0x01: emit_mov_imm(e, HOST_C, lo); emit_mov_imm(e, HOST_B, hi); break; // LXI B,D16
+		case 0x11: emit_mov_imm(e, HOST_E, lo); emit_mov_imm(e, HOST_D, hi); break; // LXI D, word
+		case 0x21: emit_mov_imm(e, HOST_L, lo); emit_mov_imm(e, HOST_H, hi); break; // LXI H, D16
+		case 0x31: emit(e, { 0x41, 0xbf }); emit32(e, imm); break; // LXI SP,word: mov r15d, imm32
+		case 0x06: case 0x0e: case 0x26: case 0x3e: // MVI r, D8
+			emit_mov_imm(e, HOST[op >> 3], lo);
+			break;
+		case 0x05: case 0x0d: case 0x3d: // DCR r
+			emit_dcr(e, HOST[op >> 3]);
+			break;
+		case 0x13: // INX D: add r12b, 1; adc r11b, 0
+			emit(e, { 0x41, 0x80, 0xc4, 0x01, 0x41, 0x80, 0xd3, 0x00 });
+			break;
+		case 0x23: // INX H: add r14b, 1; adc r13b, 0
+			emit(e, { 0x41, 0x80, 0xc6, 0x01, 0x41, 0x80, 0xd5, 0x00 });
+			break;
+		case 0x35: // DCR M, which decrements HL here: sub r14b, 1; sbb r13b, 0
+			emit(e, { 0x41, 0x80, 0xee, 0x01, 0x41, 0x80, 0xdd, 0x00 });
+			break;
+		case 0x1a: emit_pair_address(e, HOST_D, HOST_E); emit_load(e, HOST_A); break; // LDAX D
+		case 0x3a: emit(e, 0xb9); emit32(e, imm); emit_load(e, HOST_A); break; // LDA adr: mov ecx, imm32
+		case 0x56: case 0x5e: case 0x66: case 0x7e: // MOV r, M
+			emit_pair_address(e, HOST_H, HOST_L);
+			emit_load(e, HOST[(op >> 3) & 7]);
+			break;
+		case 0x6f: case 0x7a: case 0x7b: case 0x7c: case 0x7d: { // MOV r, r
+			int const dst = HOST[(op >> 3) & 7];
+			int const src = HOST[op & 7];
+			emit(e, { 0x45, 0x88, (uint8_t) (0xc0 | ((src & 7) << 3) | (dst & 7)) });
+			break; }
+		case 0xeb: // XCHG: xchg r11b, r13b; xchg r12b, r14b
+			emit(e, { 0x45, 0x86, 0xdd, 0x45, 0x86, 0xe6 });
+			break;
+
+		case 0x32: // STA adr: mov ecx, imm32
+			emit(e, 0xb9);
+			emit32(e, imm);
+			emit_store(e, HOST_A, 0, next, cycles, ops);
+			break;
+		case 0x36: emit_pair_address(e, HOST_H, HOST_L); emit_store(e, -1, lo, next, cycles, ops); break; // MVI M, D8
+		case 0x77: emit_pair_address(e, HOST_H, HOST_L); emit_store(e, HOST_A, 0, next, cycles, ops); break; // MOV M, A
+
+		case 0xc3: emit_set_pc(e, imm); break; // JMP adr
+		case 0xc2: emit_jump_cond(e, next, imm, FLAG_Z, false); break; // JNZ adr
+		case 0xca: emit_jump_cond(e, next, imm, FLAG_Z, true); break; // JZ adr
+		case 0xd2: emit_jump_cond(e, next, imm, FLAG_CY, false); break; // JNC adr
+		case 0xda: emit_jump_cond(e, next, imm, FLAG_CY, true); break; // JC adr
+
+		default: // JIT_HELPER
+			emit_store_registers(e);
+			emit_set_pc(e, address);
+			emit_call(e, (void const*) jit_run_op);
+			emit_check_written(e, cycles, ops);
+			break;
+		}
+
+		address = next;
+		if (ends_block(op)) {
+			ended = true;
+			break;
+		}
+	}
+
+	if (ops == 0) {
+		set_writable(jit, false);
+		jit->heat[pc] = JIT_COLD;
+		return NULL;
+	}
+
+	emit_store_registers(e);
+	// Jumps set pc themselves, helpers (the calls and returns) already did
+	if (!ended) {
+		emit_set_pc(e, address);
+	}
+	emit_return(e, cycles, ops);
+
+	jit->used += e.p - entry;
+	set_writable(jit, false);
+
+	JitBlock* block = new JitBlock();
+	block->start = pc;
+	block->end = address;
+	block->lead_cycles = lead_cycles;
+	block->code = (JitCode) (void*) entry;
+
+	for (int page = pc >> 8; page <= (block->end - 1) >> 8; page++) {
+		jit->on_page[page].push_back(block);
+		CPU_set_code_page(cpu, page, true);
+	}
+
+	JitBlock**& table = jit->by_pc[pc >> 8];
+	if (table == NULL) {
+		table = new JitBlock*[256]();
+	}
+	table[pc & 0xff] = block;
+
+	jit->compiled++;
+	return block;
+}
+
+/*
+	EFFECTS : runs the block at pc if there is one and it fits in remaining
+			  cycles the way the interpreter would have run it, otherwise
+			  one instruction in the interpreter. Returns the cycles and
+			  sets *ops to the number of instructions run.
+*/
+
+static int jit_step(CPU* cpu, double const remaining, int* ops) {
+	Jit* jit = cpu->jit;
+	uint16_t const pc = cpu->pc;
+
+	JitBlock** table = jit->by_pc[pc >> 8];
+	JitBlock* block = table ? table[pc & 0xff] : NULL;
+	if (block == NULL && jit->heat[pc] != JIT_COLD && ++jit->heat[pc] >= JIT_HOT) {
+		block = compile(cpu, pc);
+	}
+
+	// The interpreter starts an instruction whenever fewer than remaining
+	// cycles have run, so the whole block runs if its last one would start
+	if (block != NULL && block->lead_cycles < remaining) {
+		int const result = block->code(cpu);
+		*ops = result >> 16;
+		return result & 0xffff;
+	}
+
+	*ops = 1;
+	return EmulateI8080_op<NoTrace, EagerFlags>(cpu);
+}
+
+int cpu_run_jit(CPU* cpu, double cycles) {
+	int i = 0;
+	int ops;
+	while (i < cycles) {
+		i += jit_step(cpu, cycles - i, &ops);
+	}
+	return i;
+}
+
+long jit_verify(CPU const* cpu, int frames) {
+	CPU* native = CPU_clone(cpu);
+	CPU* interpreted = CPU_clone(cpu);
+	if (native == NULL || interpreted == NULL) {
+		if (native != NULL) {
+			CPU_free(native);
+		}
+		if (interpreted != NULL) {
+			CPU_free(interpreted);
+		}
+		return -1;
+	}
+	jit_init(native);
+	long steps = 0;
+	long checks = 0;
+	bool same = true;
+
+	for (int frame = 0; frame < frames && same; frame++) {
+		for (int half = 0; half < 2 && same; half++) {
+			int i = 0;
+			while (i < CYCLES_PER_TIC / 2) {
+				uint16_t pc = native->pc;
+				int ops;
+				int cycles = jit_step(native, CYCLES_PER_TIC / 2 - i, &ops);
+				int interpreted_cycles = 0;
+				for (int op = 0; op < ops; op++) {
+					interpreted_cycles += EmulateI8080_op<NoTrace, EagerFlags>(interpreted);
+				}
+
+				// Memory is only compared every so often, the registers after every block
+				if (cycles != interpreted_cycles || !CPU_same_registers(native, interpreted) ||
+					((checks++ & 0xff) == 0 && memcmp(native->memory, interpreted->memory, 0x10000) != 0)) {
+					printf("JIT differs after instruction %ld, %d instructions from %04x (frame %d)\n", steps, ops, pc, frame);
+					CPU_print_state("jit", native);
+					CPU_print_state("interp", interpreted);
+					same = false;
+					break;
+				}
+
+				i += cycles;
+				steps += ops;
+			}
+
+			if (same && memcmp(native->memory, interpreted->memory, 0x10000) != 0) {
+				printf("JIT: memory differs at the end of frame %d\n", frame);
+				same = false;
+			}
+
+			int interrupt = half == 0 ? 0x08 : 0x10;
+			if (native->int_enable) {
+				generate_interrupt(native, interrupt);
+			}
+			if (interpreted->int_enable) {
+				generate_interrupt(interpreted, interrupt);
+			}
+		}
+	}
+
+	if (same) {
+		printf("JIT compiled %ld blocks, dropped %ld\n", native->jit->compiled, native->jit->invalidated);
+	}
+
+	jit_free(native);
+	CPU_free(native);
+	CPU_free(interpreted);
+
+	return same ? steps : -1;
+}
+
+#else
+
+// Not an x86-64 host, everything runs in the interpreter
+
+bool jit_available() {
+	return false;
+}
+
+void jit_init(CPU* cpu) {}
+
+void jit_free(CPU* cpu) {}
+
+void jit_invalidate(CPU* cpu, uint8_t const page) {}
+
+int cpu_run_jit(CPU* cpu, double cycles) {
+	return cpu_run<NoTrace, EagerFlags>(cpu, cycles);
+}
+
+long jit_verify(CPU const* cpu, int frames) {
+	puts("JIT not available on this host");
+	return -1;
+}
+
+#endif
@@ -0,0 +1,85 @@
+#pragma once
+#include <vector>
+#include "CPU.h"
+
+// Dynamic recompiler for x86-64 hosts. Hot blocks of 8080 code are translated
+// to native code that keeps A, B, C, D, E, H, L and SP in host registers.
+// Cold code, I/O, calls, returns and pages that keep getting written run on
+// the EmulateI8080_op interpreter. The JIT always uses EagerFlags.
+//
+// A block returns the cycles it ran in the low 16 bits and the number of
+// instructions in the high bits, so a block cut short by a store into its own
+// code still reports exactly what it did.
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define I8080_JIT
+#endif
+
+typedef int (*JitCode)(CPU* cpu);
+
+struct JitBlock {
+	uint16_t start;
+	int end; // one past the last byte
+	int lead_cycles; // cycles of every instruction but the last
+	JitCode code;
+};
+
+struct Jit {
+	uint8_t* buffer; // executable code
+	size_t used;
+	size_t size;
+	JitBlock** by_pc[256]; // blocks by start address, one 256 entry table per page, allocated on demand
+	std::vector<JitBlock*> on_page[256]; // blocks with code on each page
+	uint8_t heat[0x10000]; // times the interpreter ran each address, JIT_COLD once it can't be compiled
+	uint8_t page_writes[256]; // invalidations per page, pages written too often stay interpreted
+	uint8_t written; // set when blocks are dropped, native code leaves the block when it sees it
+	long compiled;
+	long invalidated;
+};
+
+/*
+	EFFECTS : returns true when this host can run the JIT
+*/
+
+bool jit_available();
+
+/*
+	REQUIRES: jit_available()
+	Modifies: cpu->jit
+	EFFECTS : gives *cpu an empty JIT with its own code buffer
+*/
+
+void jit_init(CPU* cpu);
+
+/*
+	Modifies: cpu->jit, cpu->code_pages
+	EFFECTS : frees the JIT of *cpu and its code, if it has one
+*/
+
+void jit_free(CPU* cpu);
+
+/*
+	Modifies: cpu->jit, cpu->code_pages
+	EFFECTS : drops every native block with code on page
+*/
+
+void jit_invalidate(CPU* cpu, uint8_t const page);
+
+/*
+	REQUIRES: jit_init(cpu) was called
+	EFFECTS : Same as cpu_run<NoTrace>, running hot code natively
+*/
+
+int cpu_run_jit(CPU* cpu, double cycles);
+
+/*
+	REQUIRES: jit_available(), *cpu has a program in memory
+	EFFECTS : Runs a JIT copy of *cpu and an interpreter copy in lockstep
+			  for frames frames, raising interrupts like main() does. After
+			  every native block the interpreter runs the same instructions
+			  and both are compared. Returns the number of instructions that
+			  matched, or -1 after printing both states at the first
+			  difference or when the copies can't be made.
+*/
+
+long jit_verify(CPU const* cpu, int frames);
@@ -0,0 +1,144 @@
+#include <cstdlib>
+#include <cstring>
+#include "Machine.h"
+#include "BlockCache.h"
+#include "Bus.h"
+#include "Jit.h"
+
+Machine* machine_init() {
+	CPU* cpu = CPU_INIT();
+	if (cpu == NULL) {
+		return NULL;
+	}
+
+	Machine* machine = new Machine();
+	machine->cpu = cpu;
+	bus_map_invaders(machine->cpu);
+	machine->run = cpu_run<NoTrace, EagerFlags>;
+	scheduler_init(&machine->scheduler);
+	scheduler_start_frames(&machine->scheduler);
+	machine->hooks.input = NULL;
+	machine->hooks.present = NULL;
+	machine->hooks.scanlines = NULL;
+	machine->hooks.user = NULL;
+	machine->profile = NULL;
+	return machine;
+}
+
+void machine_free(Machine* machine) {
+	block_cache_free(machine->cpu);
+	jit_free(machine->cpu);
+	CPU_free(machine->cpu);
+	delete machine;
+}
+
+bool machine_load(Machine* machine, char const* path) {
+	return ReadFileIntoMemoryAt(machine->cpu, path);
+}
+
+void machine_load_image(Machine* machine, uint8_t const* image, size_t const size) {
+	memcpy(machine->cpu->memory, image, size);
+}
+
+bool machine_load_shared(Machine* machine, SharedRom const* rom, uint8_t const* image, size_t const size) {
+	return memory_map_rom(machine->cpu->memory, rom, image, size);
+}
+
+// Does what event stands for and queues it for the next frame
+static void handle_event(Machine* machine, Event const& event) {
+	CPU* cpu = machine->cpu;
+
+	switch (event.kind)
+	{
+	case EVENT_MID_SCREEN:
+		if (cpu->int_enable) {
+			generate_interrupt(cpu, 0x08);
+		}
+		break;
+
+	case EVENT_BEAM:
+		if (machine->hooks.scanlines != NULL) {
+			int const band = machine->scheduler.beam;
+			machine->hooks.scanlines(machine, band * BEAM_LINES, (band + 1) * BEAM_LINES);
+		}
+		break;
+
+	case EVENT_INPUT:
+		if (machine->hooks.input != NULL) {
+			machine->hooks.input(machine);
+		}
+		break;
+
+	case EVENT_PRESENT:
+		if (machine->hooks.present != NULL) {
+			machine->hooks.present(machine);
+		}
+		break;
+
+	case EVENT_END_OF_SCREEN:
+		if (cpu->int_enable) {
+			generate_interrupt(cpu, 0x10);
+		}
+		break;
+
+	case EVENT_SAMPLE:
+		profile_sample(machine->profile, machine->scheduler.last_pc);
+		break;
+	}
+
+	scheduler_repeat(&machine->scheduler, event);
+}
+
+// Handles the events the last slice ran up to or past, which leaves none due
+static void handle_due_events(Machine* machine) {
+	Scheduler* scheduler = &machine->scheduler;
+	while (scheduler->queue.front().when <= scheduler->now) {
+		handle_event(machine, scheduler_next(scheduler, machine->cpu, machine->run));
+	}
+}
+
+void machine_start_beam(Machine* machine) {
+	scheduler_start_beam(&machine->scheduler);
+}
+
+void machine_start_profile(Machine* machine, Profile* profile, uint64_t const period) {
+	machine->profile = profile;
+	machine->cpu->profile = profile;
+	scheduler_start_sampling(&machine->scheduler, period);
+}
+
+int machine_step(Machine* machine) {
+	// Every engine stops after the first instruction once a cycle has run
+	uint64_t const start = machine->scheduler.now;
+	scheduler_run(&machine->scheduler, machine->cpu, machine->run, 1);
+	handle_due_events(machine);
+	return (int) (machine->scheduler.now - start);
+}
+
+uint64_t machine_run_cycles(Machine* machine, uint64_t const cycles) {
+	Scheduler* scheduler = &machine->scheduler;
+	uint64_t const start = scheduler->now;
+	uint64_t const end = start + cycles;
+
+	// Running up to end in two slices stops on the same instruction as one
+	// slice would, so events fire on the same cycles as in machine_run_frame
+	while (scheduler->now < end) {
+		if (scheduler->queue.front().when <= end) {
+			handle_event(machine, scheduler_next(scheduler, machine->cpu, machine->run));
+		}
+		else {
+			scheduler_run(scheduler, machine->cpu, machine->run, end - scheduler->now);
+		}
+	}
+	handle_due_events(machine);
+
+	return scheduler->now - start;
+}
+
+void machine_run_frame(Machine* machine) {
+	Scheduler* scheduler = &machine->scheduler;
+	uint64_t const frame = scheduler->frame;
+	while (scheduler->frame == frame) {
+		handle_event(machine, scheduler_next(scheduler, machine->cpu, machine->run));
+	}
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "CPU.h"
+#include "Memory.h"
+#include "Scheduler.h"
+#include "Profiler.h"
+
+// A whole cabinet: the CPU with its memory and shift hardware, the frame
+// events and the engine that runs them. Machines share no state, so a
+// process can host any number of them, each on its own thread.
+//
+// Every entry point returns with no event due: whatever the last slice ran
+// up to has been handled, so it doesn't matter how a run is split into calls.
+
+struct Machine;
+
+// What a machine needs from its host at the end of every frame, and while
+// the beam runs if machine_start_beam was called. Any hook may be NULL.
+struct MachineHooks {
+	void (*input)(Machine* machine); // sample the controls into cpu->ports
+	void (*present)(Machine* machine); // show the frame
+	void (*scanlines)(Machine* machine, int first, int end); // the beam passed VRAM columns first to end - 1
+	void* user; // for the hooks
+};
+
+struct Machine {
+	CPU* cpu;
+	int (*run)(CPU*, double); // engine, any of the cpu_run functions
+	Scheduler scheduler;
+	MachineHooks hooks;
+	Profile* profile; // takes the samples, NULL unless profiling
+};
+
+/*
+	EFFECTS : returns a powered-up machine with empty memory mapped like
+			  the Space Invaders board (see bus_map_invaders), running the
+			  switch interpreter with eager flags and no hooks. Set run (and
+			  call jit_init or block_cache_init on cpu if the engine needs
+			  it) before running. Returns NULL when the CPU can't be made.
+*/
+
+Machine* machine_init();
+
+/*
+	Modifies: *machine
+	EFFECTS : frees the machine, its memory and any engine caches
+*/
+
+void machine_free(Machine* machine);
+
+/*
+	Modifies: machine->cpu->memory
+	EFFECTS : loads the ROM at path from address 0, returns false if it
+			  can't be read
+*/
+
+bool machine_load(Machine* machine, char const* path);
+
+/*
+	REQUIRES: size <= 0x10000
+	Modifies: machine->cpu->memory
+	EFFECTS : copies the ROM image of size bytes to address 0
+*/
+
+void machine_load_image(Machine* machine, uint8_t const* image, size_t size);
+
+/*
+	REQUIRES: rom was made from image, size <= 0x10000, nothing was loaded yet
+	Modifies: machine->cpu->memory
+	EFFECTS : maps the shared ROM at address 0, copy-on-write, or copies
+			  image when the host can't share it. Returns true if shared.
+*/
+
+bool machine_load_shared(Machine* machine, SharedRom const* rom, uint8_t const* image, size_t size);
+
+/*
+	Modifies: *machine
+	EFFECTS : from the next band of lines on, calls hooks.scanlines every
+			  time the beam finishes BEAM_LINES lines, so the host can
+			  convert each part of the screen as it is scanned
+*/
+
+void machine_start_beam(Machine* machine);
+
+/*
+	REQUIRES: period > 0, profile outlives the run
+	Modifies: *machine
+	EFFECTS : samples pc into profile every period cycles from now on,
+			  whatever engine runs. A run function instantiated with
+			  CoverTrace also marks its coverage.
+*/
+
+void machine_start_profile(Machine* machine, Profile* profile, uint64_t period);
+
+/*
+	Modifies: *machine
+	EFFECTS : runs one instruction and handles the events it reached.
+			  Returns its cycles.
+*/
+
+int machine_step(Machine* machine);
+
+/*
+	Modifies: *machine
+	EFFECTS : runs at least cycles cycles, handling every event reached on
+			  the way, and returns the cycles that did run
+*/
+
+uint64_t machine_run_cycles(Machine* machine, uint64_t cycles);
+
+/*
+	Modifies: *machine
+	EFFECTS : runs up to the end of the current frame, through its
+			  interrupts and hooks
+*/
+
+void machine_run_frame(Machine* machine);
@@ -0,0 +1,117 @@
+#include <cstdlib>
+#include <cstring>
+#include "Memory.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+size_t const MEMORY_SIZE = 0x10000;
+
+#ifdef _WIN32
+
+// Views of a file mapping have to start on the 64K allocation granularity,
+// which is the whole 8080 address space, so Windows hosts copy the ROM
+
+uint8_t* memory_alloc() {
+	return (uint8_t*) VirtualAlloc(NULL, MEMORY_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+}
+
+void memory_free(uint8_t* memory) {
+	VirtualFree(memory, 0, MEM_RELEASE);
+}
+
+SharedRom* shared_rom_create(uint8_t const* image, size_t size) {
+	return NULL;
+}
+
+void shared_rom_free(SharedRom* rom) {}
+
+#else
+
+struct SharedRom {
+	int fd; // ROM image, rounded up to whole host pages
+	size_t size;
+};
+
+// Anonymous file descriptor of size bytes
+static int anonymous_file(size_t const size) {
+#ifdef __linux__
+	int fd = memfd_create("i8080-rom", 0);
+#else
+	char name[] = "/tmp/i8080-rom-XXXXXX";
+	int fd = mkstemp(name);
+	if (fd >= 0) {
+		unlink(name);
+	}
+#endif
+	if (fd < 0) {
+		return -1;
+	}
+
+	if (ftruncate(fd, (off_t) size) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+uint8_t* memory_alloc() {
+	void* memory = mmap(NULL, MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return memory == MAP_FAILED ? NULL : (uint8_t*) memory;
+}
+
+void memory_free(uint8_t* memory) {
+	munmap(memory, MEMORY_SIZE);
+}
+
+SharedRom* shared_rom_create(uint8_t const* image, size_t size) {
+	size_t const page = (size_t) sysconf(_SC_PAGESIZE);
+	size_t const rounded = (size + page - 1) / page * page;
+	if (size == 0 || rounded > MEMORY_SIZE) {
+		return NULL;
+	}
+
+	int fd = anonymous_file(rounded);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	void* view = mmap(NULL, rounded, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (view == MAP_FAILED) {
+		close(fd);
+		return NULL;
+	}
+	memcpy(view, image, size);
+	munmap(view, rounded);
+
+	SharedRom* rom = new SharedRom();
+	rom->fd = fd;
+	rom->size = rounded;
+	return rom;
+}
+
+void shared_rom_free(SharedRom* rom) {
+	if (rom != NULL) {
+		close(rom->fd);
+		delete rom;
+	}
+}
+
+#endif
+
+bool memory_map_rom(uint8_t* memory, SharedRom const* rom, uint8_t const* image, size_t size) {
+#ifndef _WIN32
+	// MAP_PRIVATE: reads share the file's pages, a write copies the page
+	if (rom != NULL &&
+		mmap(memory, rom->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, rom->fd, 0) != MAP_FAILED) {
+		return true;
+	}
+#endif
+
+	memcpy(memory, image, size);
+	return false;
+}
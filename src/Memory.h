@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// 64K address spaces for the CPUs. Each CPU's memory is its own mapping of
+// zeroed pages, so the host only backs the pages a program touches. A ROM
+// loaded through a SharedRom is mapped copy-on-write over the start of that
+// space: every machine running the same ROM reads the same physical pages,
+// and a machine that writes to its ROM gets a private copy of just that page.
+// On POSIX hosts Space Invaders ends up with only its 8K of work and video
+// RAM per machine. Windows hosts commit the whole 64K and copy the ROM into
+// it, since views of a mapping can't start below 64K granularity.
+//
+// Emulated code still sees one flat 64K array, so the interpreters, the
+// block engines, the JIT and the AOT code need no changes.
+
+struct SharedRom;
+
+/*
+	EFFECTS : returns 64K of zeroed memory for a CPU
+*/
+
+uint8_t* memory_alloc();
+
+/*
+	REQUIRES: memory came from memory_alloc
+	EFFECTS : releases it, and its mapping of any shared ROM
+*/
+
+void memory_free(uint8_t* memory);
+
+/*
+	REQUIRES: size <= 0x10000
+	EFFECTS : keeps one copy of the ROM image of size bytes for every
+			  memory it is mapped into. Returns NULL if the host can't share
+			  memory between mappings; memory_map_rom then copies instead.
+*/
+
+SharedRom* shared_rom_create(uint8_t const* image, size_t size);
+
+/*
+	EFFECTS : frees rom. Memory it is mapped into keeps the ROM.
+*/
+
+void shared_rom_free(SharedRom* rom);
+
+/*
+	REQUIRES: memory came from memory_alloc and holds nothing yet
+	Modifies: memory
+	EFFECTS : puts the ROM at address 0, mapping rom's pages when rom isn't
+			  NULL and the host allows it, otherwise copying image. Returns
+			  true when the pages are shared.
+*/
+
+bool memory_map_rom(uint8_t* memory, SharedRom const* rom, uint8_t const* image, size_t size);
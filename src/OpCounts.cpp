@@ -0,0 +1,78 @@
+#include <cstdio>
+#include <cstring>
+#include "OpCounts.h"
+#include "Files.h"
+
+void op_counts_clear(OpCounts* counts) {
+	memset(counts, 0, sizeof(*counts));
+}
+
+int op_counts_compare(OpCounts const* a, OpCounts const* b) {
+	for (int op = 0; op < 256; op++) {
+		if (a->executed[op] != b->executed[op] || a->cycles[op] != b->cycles[op]
+			|| a->taken[op] != b->taken[op] || a->not_taken[op] != b->not_taken[op]) {
+			return op;
+		}
+	}
+	return -1;
+}
+
+uint64_t op_counts_total(OpCounts const* counts) {
+	uint64_t total = 0;
+	for (int op = 0; op < 256; op++) {
+		total += counts->executed[op];
+	}
+	return total;
+}
+
+static void write_csv(OpCounts const* counts, FILE* f) {
+	fprintf(f, "opcode,executed,cycles,taken,not_taken\n");
+	for (int op = 0; op < 256; op++) {
+		if (counts->executed[op] != 0) {
+			fprintf(f, "0x%02x,%llu,%llu,%llu,%llu\n", op, (unsigned long long) counts->executed[op],
+				(unsigned long long) counts->cycles[op], (unsigned long long) counts->taken[op],
+				(unsigned long long) counts->not_taken[op]);
+		}
+	}
+}
+
+// Only conditional branches get taken and not_taken
+static void write_json(OpCounts const* counts, FILE* f) {
+	fprintf(f, "{\n\t\"total\": %llu,\n\t\"opcodes\": [", (unsigned long long) op_counts_total(counts));
+	char const* separator = "\n";
+	for (int op = 0; op < 256; op++) {
+		if (counts->executed[op] == 0) {
+			continue;
+		}
+
+		fprintf(f, "%s\t\t{ \"opcode\": \"0x%02x\", \"executed\": %llu, \"cycles\": %llu", separator, op,
+			(unsigned long long) counts->executed[op], (unsigned long long) counts->cycles[op]);
+		if (op_is_conditional((uint8_t) op)) {
+			fprintf(f, ", \"taken\": %llu, \"not_taken\": %llu", (unsigned long long) counts->taken[op],
+				(unsigned long long) counts->not_taken[op]);
+		}
+		fprintf(f, " }");
+		separator = ",\n";
+	}
+	fprintf(f, "\n\t]\n}\n");
+}
+
+bool op_counts_dump(OpCounts const* counts, char const* path) {
+	FILE* f = file_open(path, "w");
+	if (f == NULL) {
+		printf("error: Couldn't create %s\n", path);
+		return false;
+	}
+
+	size_t const length = strlen(path);
+	if (length >= 5 && strcmp(path + length - 5, ".json") == 0) {
+		write_json(counts, f);
+	}
+	else {
+		write_csv(counts, f);
+	}
+
+	bool ok = ferror(f) == 0;
+	fclose(f);
+	return ok;
+}
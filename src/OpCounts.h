@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include "CPU.h"
+
+// Per-opcode instrumentation. CountTrace is a trace policy, so counting costs
+// nothing in the NoTrace builds of the cores; only the switch and threaded
+// cores, instantiated with CountTrace, count. Each opcode gets its executions
+// and the cycles they took, and conditional jumps, calls and returns also
+// whether they branched. Two engines that run the same program the same way
+// end up with the same counts.
+
+struct OpCounts {
+	uint64_t executed[256];
+	uint64_t cycles[256];
+	uint64_t taken[256]; // Jcc, Ccc and Rcc that branched
+	uint64_t not_taken[256]; // and that fell through
+	uint16_t pc; // of the instruction being run
+	uint8_t op; // its opcode
+};
+
+/*
+	EFFECTS : returns true for Jcc, Ccc and Rcc
+*/
+
+inline bool op_is_conditional(uint8_t const op) {
+	uint8_t const kind = op & 0xc7;
+	return kind == 0xc0 || kind == 0xc2 || kind == 0xc4;
+}
+
+// The trace policy: counts into cpu->counts. A conditional branch counts as
+// taken when pc ends up anywhere but the next instruction.
+struct CountTrace {
+	static void instruction(CPU* const cpu) {
+		cpu->counts->pc = cpu->pc;
+		cpu->counts->op = CPU_read(cpu, cpu->pc);
+	}
+
+	static void registers(CPU* const cpu, int const cycles) {
+		OpCounts* const counts = cpu->counts;
+		uint8_t const op = counts->op;
+		counts->executed[op]++;
+		counts->cycles[op] += cycles;
+		if (op_is_conditional(op)) {
+			uint16_t const next = counts->pc + lengths8080[op];
+			if (cpu->pc != next) {
+				counts->taken[op]++;
+			}
+			else {
+				counts->not_taken[op]++;
+			}
+		}
+	}
+
+	static void cycles(int) {}
+};
+
+/*
+	Modifies: *counts
+	EFFECTS : sets every count to 0
+*/
+
+void op_counts_clear(OpCounts* counts);
+
+/*
+	EFFECTS : returns the lowest opcode whose counts differ between a and
+			  b, or -1 if they are all the same
+*/
+
+int op_counts_compare(OpCounts const* a, OpCounts const* b);
+
+/*
+	EFFECTS : returns the executions of every opcode added up
+*/
+
+uint64_t op_counts_total(OpCounts const* counts);
+
+/*
+	EFFECTS : writes the counts of the opcodes that ran to path, as JSON if
+			  path ends in .json and as CSV otherwise. Returns false after
+			  printing an error if the file can't be written.
+*/
+
+bool op_counts_dump(OpCounts const* counts, char const* path);
@@ -0,0 +1,81 @@
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include "Pacer.h"
+#include "CPU.h"
+
+int64_t pacer_now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void pacer_init(Pacer* pacer, double const speed, int const max_skip) {
+	pacer->speed = speed;
+	pacer->period = speed > 0 ? (int64_t) (TIC * 1e6 / speed) : 0;
+	pacer->start = pacer_now();
+	pacer->deadline = pacer->start + pacer->period;
+	pacer->frames = 0;
+	pacer->max_skip = max_skip;
+	pacer->skip = false;
+	pacer->skip_run = 0;
+	pacer->late = 0;
+	pacer->skipped = 0;
+	pacer->jitter_total = 0;
+	pacer->jitter_max = 0;
+	pacer->idle = 0;
+}
+
+bool pacer_wait(Pacer* pacer) {
+	pacer->frames++;
+	if (pacer->skip) {
+		pacer->skipped++;
+		pacer->skip_run++;
+	}
+	else {
+		pacer->skip_run = 0;
+	}
+
+	if (pacer->period == 0) {
+		return true;
+	}
+
+	int64_t now = pacer_now();
+	bool const on_time = now <= pacer->deadline;
+	if (on_time) {
+		int64_t const wake = pacer->deadline - PACER_SPIN;
+		if (now < wake) {
+			std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(wake)));
+			int64_t const woke = pacer_now();
+			pacer->idle += woke - now;
+			now = woke;
+		}
+		while (now < pacer->deadline) {
+			now = pacer_now();
+		}
+	}
+	else {
+		pacer->late++;
+	}
+
+	int64_t const jitter = now - pacer->deadline;
+	pacer->jitter_total += jitter;
+	pacer->jitter_max = jitter > pacer->jitter_max ? jitter : pacer->jitter_max;
+
+	// Behind by less than the frames it may still skip: stay on schedule
+	bool const catch_up = !on_time && pacer->skip_run < pacer->max_skip
+		&& jitter < pacer->max_skip * pacer->period;
+	pacer->skip = catch_up;
+	pacer->deadline = (on_time || catch_up ? pacer->deadline : now) + pacer->period;
+	return on_time || catch_up;
+}
+
+void pacer_report(Pacer const* pacer) {
+	if (pacer->period == 0 || pacer->frames == 0) {
+		return;
+	}
+
+	double const elapsed = (double) (pacer_now() - pacer->start);
+	printf("%llu frames at %gx: %llu late, %llu skipped, jitter %.1f us average, %.1f us worst, %.0f%% of the time asleep\n",
+		(unsigned long long) pacer->frames, pacer->speed, (unsigned long long) pacer->late,
+		(unsigned long long) pacer->skipped,
+		pacer->jitter_total / 1e3 / pacer->frames, pacer->jitter_max / 1e3, 100 * pacer->idle / elapsed);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+
+// Frame pacing on the monotonic clock, in nanoseconds. Every frame has a
+// deadline one frame time after the last one. The pacer sleeps until just
+// before it and spins only the last PACER_SPIN, so waiting leaves the core
+// idle and still ends within microseconds of the deadline. A frame that
+// misses its deadline starts the schedule over from then instead of rushing
+// the next frames to catch up.
+//
+// Unless frames may be skipped: then a late frame keeps the schedule and the
+// host leaves the next frames undrawn while pacer.skip is set, so emulation
+// gets back to real time on the time drawing took. After max_skip frames in
+// a row, or when a whole max_skip frames behind, the pacer gives up and
+// starts over from now.
+
+int64_t const PACER_SPIN = 1000000; // sleeps can wake this late
+
+struct Pacer {
+	double speed; // multiple of the cabinet's 60 frames/s, 0 for no pacing
+	int64_t period; // nanoseconds per frame
+	int64_t start; // clock at pacer_init
+	int64_t deadline; // when the current frame is due to end
+	uint64_t frames; // frames waited for
+	int max_skip; // frames in a row that may go undrawn, 0 to never skip
+	bool skip; // leave the current frame undrawn
+	int skip_run; // frames skipped in a row before the current one
+	uint64_t late; // frames that ended past their deadline
+	uint64_t skipped; // frames left undrawn
+	int64_t jitter_total; // distance of each frame's end from its deadline
+	int64_t jitter_max;
+	int64_t idle; // time spent asleep
+};
+
+/*
+	EFFECTS : returns the monotonic clock in nanoseconds
+*/
+
+int64_t pacer_now();
+
+/*
+	REQUIRES: speed >= 0, max_skip >= 0
+	Modifies: *pacer
+	EFFECTS : starts pacing frames at speed times 60 per second, from now,
+			  skipping at most max_skip in a row. With speed 0 frames aren't
+			  held back or skipped at all.
+*/
+
+void pacer_init(Pacer* pacer, double speed, int max_skip);
+
+/*
+	Modifies: *pacer
+	EFFECTS : waits for the end of the current frame and moves on to the
+			  next one, setting skip if it should go undrawn. Returns false
+			  if the frame was late and skipping can't make up for it.
+*/
+
+bool pacer_wait(Pacer* pacer);
+
+/*
+	EFFECTS : prints how many frames were late and skipped, the average and worst
+			  distance of a frame's end from its deadline, and the share of
+			  the time spent asleep
+*/
+
+void pacer_report(Pacer const* pacer);
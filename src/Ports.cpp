@@ -0,0 +1,69 @@
+#include "Ports.h"
+
+// Defaults for ports no device claims
+static uint8_t unmapped_read(CPU* cpu, uint8_t port) {
+	return cpu->a;
+}
+
+static void unmapped_write(CPU* cpu, uint8_t port, uint8_t val) {
+}
+
+// Input ports, set by the front end or an input script
+static uint8_t input_read(CPU* cpu, uint8_t port) {
+	return cpu->ports[port];
+}
+
+// Shifter: writes to port 4 shift a byte into the top of a 16 bit register,
+// port 3 reads 8 bits of it starting offset bits below the top
+static uint8_t shift_read(CPU* cpu, uint8_t port) {
+	return (uint8_t) (cpu->shift.value >> (8 - cpu->shift.offset));
+}
+
+static void shift_offset_write(CPU* cpu, uint8_t port, uint8_t val) {
+	cpu->shift.offset = val & 0x7;
+}
+
+static void shift_data_write(CPU* cpu, uint8_t port, uint8_t val) {
+	cpu->shift.value = (uint16_t) ((val << 8) | (cpu->shift.value >> 8));
+}
+
+// Sound ports, latched for whoever plays the samples
+static void sound_write(CPU* cpu, uint8_t port, uint8_t val) {
+	cpu->ports[port] = val;
+}
+
+// The watchdog resets the board when it isn't kicked; emulated code always
+// keeps up, so kicks need no state
+static void watchdog_write(CPU* cpu, uint8_t port, uint8_t val) {
+}
+
+void port_map_clear(PortMap* map) {
+	for (int port = 0; port < 256; port++) {
+		map->read[port] = unmapped_read;
+		map->write[port] = unmapped_write;
+	}
+}
+
+void port_map_add_invaders(PortMap* map) {
+	map->read[0] = input_read;
+	map->read[1] = input_read;
+	map->read[2] = input_read;
+	map->read[3] = shift_read;
+	map->write[2] = shift_offset_write;
+	map->write[3] = sound_write;
+	map->write[4] = shift_data_write;
+	map->write[5] = sound_write;
+	map->write[6] = watchdog_write;
+}
+
+PortMap const* port_map_invaders() {
+	// Filled once, machines on other threads may already be running
+	static PortMap map;
+	static bool const filled = [] {
+		port_map_clear(&map);
+		port_map_add_invaders(&map);
+		return true;
+	}();
+	(void) filled;
+	return &map;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "CPU.h"
+
+// I/O port devices. IN and OUT each make one indexed call through the CPU's
+// PortMap, so a board is just the handlers it puts in the table. Ports no
+// device claims go to cheap defaults: reads leave A as it was, writes are
+// dropped.
+//
+// Handlers keep their state in the CPU (cpu->ports, cpu->shift), so one map
+// serves every machine and cloning a CPU clones its devices. They must not
+// store to memory: the block engine runs IN and OUT inside its blocks.
+
+typedef uint8_t (*PortRead)(CPU* cpu, uint8_t port);
+typedef void (*PortWrite)(CPU* cpu, uint8_t port, uint8_t val);
+
+struct PortMap {
+	PortRead read[256];
+	PortWrite write[256];
+};
+
+/*
+	Modifies: *map
+	EFFECTS : points every port of map at the defaults
+*/
+
+void port_map_clear(PortMap* map);
+
+/*
+	Modifies: *map
+	EFFECTS : registers the Space Invaders devices in map: the inputs on
+			  read ports 0-2, the shifter on read port 3 and write ports 2
+			  and 4, the sound latches on write ports 3 and 5 and the
+			  watchdog on write port 6
+*/
+
+void port_map_add_invaders(PortMap* map);
+
+/*
+	EFFECTS : returns a map with only the Space Invaders devices, shared by
+			  every CPU. A new CPU starts out with it.
+*/
+
+PortMap const* port_map_invaders();
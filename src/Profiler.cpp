@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "Profiler.h"
+#include "Disassembler.h"
+
+int const MAX_BLOCK_OPS = 64;
+
+// Jumps, calls, returns, RST and PCHL end a block
+static bool ends_block(uint8_t const op) {
+	uint8_t const kind = op & 0xc7;
+	return kind == 0xc0 || kind == 0xc2 || kind == 0xc4 || kind == 0xc7
+		|| op == 0xc3 || op == 0xc9 || op == 0xcd || op == 0xe9;
+}
+
+// Where the JMP, Jcc, CALL, Ccc or RST at pc goes, -1 for other instructions
+static int branch_target(uint8_t const* code, int const pc) {
+	uint8_t const op = code[pc];
+	uint8_t const kind = op & 0xc7;
+	if (kind == 0xc2 || kind == 0xc4 || op == 0xc3 || op == 0xcd) {
+		return code[pc + 1] | (code[pc + 2] << 8);
+	}
+	if (kind == 0xc7) {
+		return op & 0x38;
+	}
+	return -1;
+}
+
+// A straight line of instructions from a sampled address or a branch target
+// to the first instruction that ends a block or the next branch target
+struct HotBlock {
+	uint16_t start;
+	uint16_t last; // address of its last instruction
+	int ops;
+	uint64_t hits;
+};
+
+void profile_init(Profile* profile, uint64_t const period) {
+	memset(profile->hits, 0, sizeof(profile->hits));
+	profile->samples = 0;
+	profile->period = period;
+	memset(profile->covered, 0, sizeof(profile->covered));
+	profile->coverage = false;
+}
+
+void profile_report(Profile const* profile, CPU const* cpu, int const top) {
+	// The disassembler reads flat memory, so the address space is copied
+	// out through the bus, with room for an instruction at ffff
+	static uint8_t code[0x10002];
+	for (int address = 0; address < 0x10000; address++) {
+		code[address] = CPU_read(cpu, (uint16_t) address);
+	}
+
+	std::vector<uint16_t> addresses;
+	for (int address = 0; address < 0x10000; address++) {
+		if (profile->hits[address] != 0) {
+			addresses.push_back((uint16_t) address);
+		}
+	}
+
+	printf("%llu samples, one every %llu cycles, at %d addresses\n",
+		(unsigned long long) profile->samples, (unsigned long long) profile->period, (int) addresses.size());
+	if (profile->coverage) {
+		int covered = 0;
+		for (int address = 0; address < 0x10000; address++) {
+			covered += profile_covered(profile, (uint16_t) address);
+		}
+		printf("Instructions ran from %d addresses\n", covered);
+	}
+	else {
+		puts("No coverage: only the switch and threaded interpreters keep it, without --trace or --count-ops");
+	}
+	if (profile->samples == 0) {
+		return;
+	}
+	double const percent = 100.0 / profile->samples;
+
+	// Branch targets in the code the samples land in. Straight lines are
+	// followed from every sampled address the same way blocks are below.
+	static bool target[0x10000];
+	memset(target, 0, sizeof(target));
+	int scanned = 0;
+	for (uint16_t const address : addresses) {
+		if (address < scanned) {
+			continue;
+		}
+		int pc = address;
+		for (int ops = 0; pc < 0x10000 && ops < MAX_BLOCK_OPS; ops++) {
+			uint8_t const op = code[pc];
+			int const to = branch_target(code, pc);
+			if (to >= 0) {
+				target[to] = true;
+			}
+			pc += lengths8080[op];
+			if (ends_block(op)) {
+				break;
+			}
+		}
+		scanned = pc;
+	}
+
+	// Blocks start at the lowest sampled address not in a block yet and at
+	// every branch target, so a loop is a block of its own and not the tail
+	// of the code that runs into it. The line goes on through targets
+	// until a block with no samples.
+	std::vector<HotBlock> blocks;
+	int next_free = 0;
+	for (uint16_t const address : addresses) {
+		if (address < next_free) {
+			continue;
+		}
+
+		int pc = address;
+		HotBlock block = { address, address, 0, 0 };
+		while (pc < 0x10000) {
+			block.last = (uint16_t) pc;
+			block.hits += profile->hits[pc];
+			block.ops++;
+			uint8_t const op = code[pc];
+			pc += lengths8080[op];
+			bool const ends = ends_block(op) || block.ops == MAX_BLOCK_OPS || pc >= 0x10000;
+			if (!ends && !target[pc]) {
+				continue;
+			}
+			if (block.hits == 0) {
+				break;
+			}
+			blocks.push_back(block);
+			if (ends) {
+				break;
+			}
+			block = { (uint16_t) pc, (uint16_t) pc, 0, 0 };
+		}
+		next_free = pc;
+	}
+
+	std::sort(addresses.begin(), addresses.end(), [profile](uint16_t const a, uint16_t const b) {
+		return profile->hits[a] != profile->hits[b] ? profile->hits[a] > profile->hits[b] : a < b;
+	});
+	std::sort(blocks.begin(), blocks.end(), [](HotBlock const& a, HotBlock const& b) {
+		return a.hits != b.hits ? a.hits > b.hits : a.start < b.start;
+	});
+
+	printf("\nHot addresses:\n");
+	for (int i = 0; i < top && i < (int) addresses.size(); i++) {
+		uint16_t const address = addresses[i];
+		printf("%10u %5.1f%%  ", profile->hits[address], profile->hits[address] * percent);
+		disassemble_8080_op_code(code, address);
+	}
+
+	printf("\nHot blocks:\n");
+	for (int i = 0; i < top && i < (int) blocks.size(); i++) {
+		HotBlock const& block = blocks[i];
+		printf("%10llu %5.1f%%  %04x-%04x, %d instructions\n", (unsigned long long) block.hits,
+			block.hits * percent, block.start, block.last, block.ops);
+		for (int pc = block.start; pc <= block.last; pc += lengths8080[code[pc]]) {
+			printf("%10u         ", profile->hits[pc]);
+			disassemble_8080_op_code(code, pc);
+		}
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include "CPU.h"
+
+// Sampling profiler for the emulated program. The machine's scheduler takes
+// the address of the instruction running every so many cycles (see
+// machine_start_profile), so it works the same with every engine and costs
+// one event per sample. Samples go into a histogram over the 64K address
+// space. The report ranks the hottest addresses and the basic blocks around
+// them, split at every branch target, disassembled, to find the loops worth
+// skipping, fusing or compiling.
+//
+// Samples miss code that runs rarely, so the switch and threaded cores can
+// also keep a coverage bitmap: run with the CoverTrace policy, they mark
+// every address an instruction runs from.
+
+struct Profile {
+	uint32_t hits[0x10000]; // samples per address
+	uint64_t samples;
+	uint64_t period; // cycles per sample, for the report
+	uint8_t covered[0x10000 / 8]; // one bit per address an instruction ran from
+	bool coverage; // whether a CoverTrace core filled covered
+};
+
+/*
+	Modifies: *profile
+	EFFECTS : empties profile, which is sampled every period cycles
+*/
+
+void profile_init(Profile* profile, uint64_t period);
+
+/*
+	Modifies: *profile
+	EFFECTS : counts a sample at pc
+*/
+
+inline void profile_sample(Profile* profile, uint16_t const pc) {
+	profile->hits[pc]++;
+	profile->samples++;
+}
+
+/*
+	Modifies: *profile
+	EFFECTS : marks pc as covered
+*/
+
+inline void profile_cover(Profile* profile, uint16_t const pc) {
+	profile->covered[pc >> 3] |= (uint8_t) (1 << (pc & 7));
+}
+
+/*
+	EFFECTS : returns whether an instruction ran from pc
+*/
+
+inline bool profile_covered(Profile const* profile, uint16_t const pc) {
+	return (profile->covered[pc >> 3] >> (pc & 7)) & 1;
+}
+
+// The trace policy: marks every instruction's address in cpu->profile
+struct CoverTrace {
+	static void instruction(CPU* const cpu) {
+		profile_cover(cpu->profile, cpu->pc);
+	}
+
+	static void registers(CPU*, int) {}
+	static void cycles(int) {}
+};
+
+/*
+	REQUIRES: cpu holds the program that was profiled
+	EFFECTS : prints the top addresses and the top blocks by samples, each
+			  with its share and its disassembly read from cpu's memory,
+			  and how many addresses were covered if coverage was kept
+*/
+
+void profile_report(Profile const* profile, CPU const* cpu, int top);
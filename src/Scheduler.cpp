@@ -0,0 +1,128 @@
+#include <algorithm>
+#include "Scheduler.h"
+
+int const MAX_INSTRUCTION_CYCLES = 18; // XTHL
+
+// Heap order for std::push_heap and std::pop_heap, which keep the largest
+// element on top: an event is "less" when it is due later
+static bool later(Event const& a, Event const& b) {
+	if (a.when != b.when) {
+		return a.when > b.when;
+	}
+	return a.kind > b.kind;
+}
+
+// Cycle at which fraction of frame has run. Computed from the frame number
+// every time, so the fraction of a cycle in CYCLES_PER_TIC never adds up.
+static uint64_t frame_cycle(uint64_t const frame, double const fraction) {
+	return (uint64_t) ((frame + fraction) * CYCLES_PER_TIC);
+}
+
+void scheduler_init(Scheduler* scheduler) {
+	scheduler->now = 0;
+	scheduler->frame = 0;
+	scheduler->beam = 0;
+	scheduler->sample_period = 0;
+	scheduler->last_pc = 0;
+	scheduler->queue.clear();
+}
+
+void scheduler_start_frames(Scheduler* scheduler) {
+	scheduler_add(scheduler, frame_cycle(scheduler->frame, 0.5), EVENT_MID_SCREEN);
+	scheduler_add(scheduler, frame_cycle(scheduler->frame + 1, 0), EVENT_INPUT);
+	scheduler_add(scheduler, frame_cycle(scheduler->frame + 1, 0), EVENT_PRESENT);
+	scheduler_add(scheduler, frame_cycle(scheduler->frame + 1, 0), EVENT_END_OF_SCREEN);
+}
+
+// Cycle at which the beam finishes band of frame
+static uint64_t beam_cycle(uint64_t const frame, int const band) {
+	return frame_cycle(frame, (band + 1.0) / BEAM_BANDS);
+}
+
+void scheduler_start_beam(Scheduler* scheduler) {
+	int band = 0;
+	while (band < BEAM_BANDS && beam_cycle(scheduler->frame, band) <= scheduler->now) {
+		band++;
+	}
+
+	if (band < BEAM_BANDS) {
+		scheduler->beam = band;
+		scheduler_add(scheduler, beam_cycle(scheduler->frame, band), EVENT_BEAM);
+	}
+	else {
+		scheduler->beam = 0;
+		scheduler_add(scheduler, beam_cycle(scheduler->frame + 1, 0), EVENT_BEAM);
+	}
+}
+
+void scheduler_start_sampling(Scheduler* scheduler, uint64_t const period) {
+	scheduler->sample_period = period;
+	scheduler_add(scheduler, scheduler->now + period, EVENT_SAMPLE);
+}
+
+void scheduler_repeat(Scheduler* scheduler, Event const& event) {
+	if (event.kind == EVENT_SAMPLE) {
+		scheduler_add(scheduler, event.when + scheduler->sample_period, event.kind);
+		return;
+	}
+
+	// The last band ends with the frame, before end of screen moves frame on
+	if (event.kind == EVENT_BEAM) {
+		scheduler->beam = (scheduler->beam + 1) % BEAM_BANDS;
+		uint64_t const frame = scheduler->beam == 0 ? scheduler->frame + 1 : scheduler->frame;
+		scheduler_add(scheduler, beam_cycle(frame, scheduler->beam), event.kind);
+		return;
+	}
+
+	// The end of frame events fire with frame still counting the frame
+	// they end, and mid-screen comes before them
+	if (event.kind == EVENT_MID_SCREEN) {
+		scheduler_add(scheduler, frame_cycle(scheduler->frame + 1, 0.5), event.kind);
+	}
+	else {
+		scheduler_add(scheduler, frame_cycle(scheduler->frame + 2, 0), event.kind);
+	}
+
+	if (event.kind == EVENT_END_OF_SCREEN) {
+		scheduler->frame++;
+	}
+}
+
+void scheduler_add(Scheduler* scheduler, uint64_t const when, uint8_t const kind) {
+	Event event;
+	event.when = when;
+	event.kind = kind;
+	scheduler->queue.push_back(event);
+	std::push_heap(scheduler->queue.begin(), scheduler->queue.end(), later);
+}
+
+void scheduler_run(Scheduler* scheduler, CPU* cpu, int (*run)(CPU*, double), uint64_t const cycles) {
+	if (scheduler->sample_period == 0) {
+		scheduler->now += run(cpu, (double) cycles);
+		return;
+	}
+
+	// A sample is due on the last cycle. By then pc points past the
+	// instruction that ran on it, so the slice stops short of it, at least
+	// one cycle early (engines stop on the same instructions however a run
+	// is sliced), and the rest is stepped.
+	uint64_t const end = scheduler->now + cycles;
+	if (cycles > MAX_INSTRUCTION_CYCLES) {
+		scheduler->now += run(cpu, (double) (cycles - MAX_INSTRUCTION_CYCLES));
+	}
+	while (scheduler->now < end) {
+		scheduler->last_pc = cpu->pc;
+		scheduler->now += run(cpu, 1);
+	}
+}
+
+Event scheduler_next(Scheduler* scheduler, CPU* cpu, int (*run)(CPU*, double)) {
+	Event const next = scheduler->queue.front();
+	if (next.when > scheduler->now) {
+		scheduler_run(scheduler, cpu, run, next.when - scheduler->now);
+	}
+
+	std::pop_heap(scheduler->queue.begin(), scheduler->queue.end(), later);
+	scheduler->queue.pop_back();
+	return next;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "CPU.h"
+
+// Cycle-stamped event queue. The CPU runs in one slice up to the earliest
+// event; whatever the last instruction overshoots stays on the clock, so the
+// next slice is that much shorter and the emulated time never drifts.
+
+// Kinds in the order events due on the same cycle fire
+enum EventKind : uint8_t {
+	EVENT_MID_SCREEN, // RST 1, the beam reached the middle of the screen
+	EVENT_BEAM, // the beam finished a band of BEAM_LINES lines
+	EVENT_INPUT, // sample the controls into the input ports
+	EVENT_PRESENT, // show the frame and wait for the host's frame time
+	EVENT_END_OF_SCREEN, // RST 2, vertical blank
+	EVENT_SAMPLE, // the profiler takes pc, every sample_period cycles
+};
+
+// The beam sweeps the 224 lines of the screen (VRAM columns) evenly over a
+// frame, so it is at line 112 at mid-screen. It is followed in bands of 8
+// lines, the width of a video_expand tile.
+int const BEAM_LINES = 8;
+int const BEAM_BANDS = 224 / BEAM_LINES;
+
+struct Event {
+	uint64_t when; // cycle the event is due on
+	uint8_t kind;
+};
+
+struct Scheduler {
+	uint64_t now; // cycles run since the start
+	uint64_t frame; // frames finished
+	int beam; // band the next EVENT_BEAM ends
+	uint64_t sample_period; // cycles between EVENT_SAMPLEs
+	uint16_t last_pc; // while sampling, address of the instruction that ran on the last cycle
+	std::vector<Event> queue; // binary heap, earliest first
+};
+
+/*
+	Modifies: *scheduler
+	EFFECTS : empties the queue and sets the clock to 0
+*/
+
+void scheduler_init(Scheduler* scheduler);
+
+/*
+	Modifies: *scheduler
+	EFFECTS : queues the events of the first frame. A frame is
+			  CYCLES_PER_TIC cycles: RST 1 comes mid-screen, and at the end
+			  of the screen the controls are read, the frame is shown and
+			  RST 2 is raised.
+*/
+
+void scheduler_start_frames(Scheduler* scheduler);
+
+/*
+	REQUIRES: scheduler_start_frames was called
+	Modifies: *scheduler
+	EFFECTS : queues an EVENT_BEAM for the end of every band of lines from
+			  the next one on
+*/
+
+void scheduler_start_beam(Scheduler* scheduler);
+
+/*
+	REQUIRES: period > 0
+	Modifies: *scheduler
+	EFFECTS : queues an EVENT_SAMPLE every period cycles from now on
+*/
+
+void scheduler_start_sampling(Scheduler* scheduler, uint64_t period);
+
+/*
+	REQUIRES: event came from scheduler_next and was started by
+			  scheduler_start_frames, scheduler_start_beam or
+			  scheduler_start_sampling
+	Modifies: *scheduler
+	EFFECTS : queues event again for the next frame, counting the frame as
+			  finished after its end of screen. EVENT_BEAM goes on to the
+			  next band and EVENT_SAMPLE comes back a period later.
+*/
+
+void scheduler_repeat(Scheduler* scheduler, Event const& event);
+
+/*
+	Modifies: *scheduler
+	EFFECTS : adds an event of kind due on cycle when
+*/
+
+void scheduler_add(Scheduler* scheduler, uint64_t const when, uint8_t const kind);
+
+/*
+	Modifies: *scheduler, *cpu
+	EFFECTS : runs cpu with run for cycles cycles, or until the instruction
+			  running then ends, and moves the clock on. While sampling, the
+			  last instructions run one at a time to keep last_pc.
+*/
+
+void scheduler_run(Scheduler* scheduler, CPU* cpu, int (*run)(CPU*, double), uint64_t cycles);
+
+/*
+	REQUIRES: the queue is not empty, run returns the cycles it ran
+	Modifies: *scheduler, *cpu
+	EFFECTS : Runs cpu with run until the earliest event is due, then removes
+			  and returns it
+*/
+
+Event scheduler_next(Scheduler* scheduler, CPU* cpu, int (*run)(CPU*, double));
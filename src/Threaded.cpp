@@ -0,0 +1,382 @@
+#include "Threaded.h"
+#include "Flags.h"
+#include "OpCounts.h"
+#include "Profiler.h"
+
+#ifdef I8080_COMPUTED_GOTO
+
+// Every handler ends in NEXT, which charges the handler's own cycle count and
+// jumps straight to the handler of the following opcode. Each handler thus has
+// its own indirect branch, which the host predicts far better than the single
+// one shared by all 256 cases of the switch in EmulateI8080_op. The handlers
+// mirror that switch case for case, and call the trace policy at the same
+// points.
+
+#define DISPATCH \
+	Trace::cycles(i); \
+	opcode = CPU_fetch(cpu, fetched); \
+	Trace::instruction(cpu); \
+	cpu->pc += 1; \
+	goto *dispatch[*opcode]
+
+#define NEXT(n) \
+	{ int const spent = (n); \
+	  Trace::registers(cpu, spent); \
+	  i += spent; } \
+	if (i >= cycles) return i; \
+	DISPATCH
+
+bool threaded_available() {
+	return true;
+}
+
+template <typename Flags, typename Trace>
+int cpu_run_threaded(CPU* cpu, double cycles) {
+	static void* const dispatch[256] = {
+		&&op_00, &&op_01, &&unimplemented, &&unimplemented, &&unimplemented, &&op_05, &&op_06, &&unimplemented,
+		&&unimplemented, &&op_09, &&unimplemented, &&unimplemented, &&unimplemented, &&op_0d, &&op_0e, &&op_0f,
+		&&unimplemented, &&op_11, &&unimplemented, &&op_13, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented,
+		&&unimplemented, &&op_19, &&op_1a, &&unimplemented, &&unimplemented, &&unimplemented, &&op_1e, &&unimplemented,
+		&&unimplemented, &&op_21, &&unimplemented, &&op_23, &&unimplemented, &&unimplemented, &&op_26, &&op_27,
+		&&unimplemented, &&op_29, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented,
+		&&unimplemented, &&op_31, &&op_32, &&unimplemented, &&unimplemented, &&op_35, &&op_36, &&unimplemented,
+		&&unimplemented, &&unimplemented, &&op_3a, &&unimplemented, &&unimplemented, &&op_3d, &&op_3e, &&unimplemented,
+		&&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented,
+		&&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented,
+		&&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&op_56, &&unimplemented,
+		&&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&op_5e, &&unimplemented,
+		&&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&op_66, &&unimplemented,
+		&&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&op_6f,
+		&&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&op_77,
+		&&unimplemented, &&unimplemented, &&op_7a, &&op_7b, &&op_7c, &&op_7d, &&op_7e, &&unimplemented,
+		&&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented,
+		&&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented,
+		&&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented,
+		&&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented,
+		&&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&op_a7,
+		&&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&op_af,
+		&&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented,
+		&&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented,
+		&&op_c0, &&op_c1, &&op_c2, &&op_c3, &&unimplemented, &&op_c5, &&op_c6, &&unimplemented,
+		&&op_c8, &&op_c9, &&op_ca, &&unimplemented, &&unimplemented, &&op_cd, &&unimplemented, &&unimplemented,
+		&&unimplemented, &&op_d1, &&op_d2, &&op_d3, &&unimplemented, &&op_d5, &&unimplemented, &&unimplemented,
+		&&unimplemented, &&unimplemented, &&op_da, &&op_db, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented,
+		&&unimplemented, &&op_e1, &&unimplemented, &&unimplemented, &&unimplemented, &&op_e5, &&op_e6, &&unimplemented,
+		&&unimplemented, &&unimplemented, &&unimplemented, &&op_eb, &&unimplemented, &&unimplemented, &&unimplemented, &&unimplemented,
+		&&unimplemented, &&op_f1, &&unimplemented, &&unimplemented, &&unimplemented, &&op_f5, &&unimplemented, &&unimplemented,
+		&&unimplemented, &&unimplemented, &&unimplemented, &&op_fb, &&unimplemented, &&unimplemented, &&op_fe, &&unimplemented,
+	};
+
+	int i = 0;
+	uint8_t fetched[3];
+	unsigned char* opcode;
+
+	if (i >= cycles) return i;
+	DISPATCH;
+
+	op_00: // NOP
+		NOP(cpu);
+		NEXT(4);
+
+	op_01: // LXI B,D16
+		cpu->c = opcode[1];
+		cpu->b = opcode[2];
+		cpu->pc += 2;
+		NEXT(10);
+
+	op_05: // DCR B
+		DCR<Flags>(cpu, cpu->b);
+		NEXT(5);
+
+	op_06: // MVI B, D8
+		MOV(cpu->b, opcode[1]);
+		cpu->pc++;
+		NEXT(7);
+
+	op_09: // DAD B
+		DAD(cpu, CPU_get_bc(cpu));
+		NEXT(10);
+
+	op_0d: // DCR C
+		DCR<Flags>(cpu, cpu->c);
+		NEXT(5);
+
+	op_0e: // MVI C, D8
+		MOV(cpu->c, opcode[1]);
+		cpu->pc++;
+		NEXT(7);
+
+	op_0f: // RRC
+		RRC(cpu);
+		NEXT(4);
+
+	op_11: // LXI D, word
+		cpu->e = opcode[1];
+		cpu->d = opcode[2];
+		cpu->pc += 2;
+		NEXT(10);
+
+	op_13: // INX D
+		CPU_set_de(cpu, CPU_get_de(cpu) + 1);
+		NEXT(5);
+
+	op_1e: // not decoded by EmulateI8080_op either, runs as a NOP
+		NEXT(7);
+
+	op_19: // DAD D
+		DAD(cpu, CPU_get_de(cpu));
+		NEXT(10);
+
+	op_1a: // LDAX D
+		MOV(cpu->a, CPU_read(cpu, CPU_get_de(cpu)));
+		NEXT(7);
+
+	op_21: // LXI H, D16
+		cpu->l = opcode[1];
+		cpu->h = opcode[2];
+		cpu->pc += 2;
+		NEXT(10);
+
+	op_23: // INX H
+		cpu->l++;
+		if (cpu->l == 0)
+			cpu->h++;
+		NEXT(5);
+
+	op_26: // MVI H, D8
+		MOV(cpu->h, opcode[1]);
+		cpu->pc++;
+		NEXT(7);
+
+	op_27: // DAA
+		DAA<Flags>(cpu);
+		NEXT(4);
+
+	op_29: // DAD H
+		DAD(cpu, CPU_get_hl(cpu));
+		NEXT(10);
+
+	op_31: // LXI SP,word
+		cpu->sp = (opcode[2] << 8) | opcode[1];
+		cpu->pc += 2;
+		NEXT(10);
+
+	op_32: // STA adr
+		CPU_write(cpu, (opcode[2] << 8) | (opcode[1]), cpu->a);
+		cpu->pc += 2;
+		NEXT(13);
+
+	op_35: // DCR M
+		CPU_set_hl(cpu, CPU_get_hl(cpu) - 1);
+		NEXT(10);
+
+	op_36: // MVI M, D8
+		CPU_write(cpu, CPU_get_hl(cpu), opcode[1]);
+		cpu->pc++;
+		NEXT(10);
+
+	op_3a: // LDA adr
+		MOV(cpu->a, CPU_read(cpu, (opcode[2] << 8) | (opcode[1])));
+		cpu->pc += 2;
+		NEXT(13);
+
+	op_3d: // DCR A
+		DCR<Flags>(cpu, cpu->a);
+		NEXT(5);
+
+	op_3e: // MVI A, D8
+		MOV(cpu->a, opcode[1]);
+		cpu->pc++;
+		NEXT(7);
+
+	op_56: // MOV D, M
+		MOV(cpu->d, CPU_read(cpu, CPU_get_hl(cpu)));
+		NEXT(7);
+
+	op_5e: // MOV E, M
+		MOV(cpu->e, CPU_read(cpu, CPU_get_hl(cpu)));
+		NEXT(7);
+
+	op_66: // MOV H, M
+		MOV(cpu->h, CPU_read(cpu, CPU_get_hl(cpu)));
+		NEXT(7);
+
+	op_6f: // MOV L, A
+		MOV(cpu->l, cpu->a);
+		NEXT(5);
+
+	op_77: // MOV M, A
+		CPU_write(cpu, CPU_get_hl(cpu), cpu->a);
+		NEXT(7);
+
+	op_7a: // MOV A, D
+		MOV(cpu->a, cpu->d);
+		NEXT(5);
+
+	op_7b: // MOV A, E
+		MOV(cpu->a, cpu->e);
+		NEXT(5);
+
+	op_7c: // MOV A, H
+		MOV(cpu->a, cpu->h);
+		NEXT(5);
+
+	op_7d: // MOV A, L
+		MOV(cpu->a, cpu->l);
+		NEXT(5);
+
+	op_7e: // MOV A, M
+		MOV(cpu->a, CPU_read(cpu, CPU_get_hl(cpu)));
+		NEXT(7);
+
+	op_a7: // ANA A
+		ANA<Flags>(cpu, cpu->a);
+		NEXT(4);
+
+	op_af: // XRA A
+		XRA<Flags>(cpu, cpu->a);
+		NEXT(4);
+
+	op_c0: // RNZ
+		Flags::sync(cpu);
+		NEXT(RET_COND(cpu, cpu->cc.z != 0) ? 11 : CYCLES_RET_SKIPPED);
+
+	op_c1: // POP B
+		POP(cpu, "B");
+		NEXT(10);
+
+	op_c2: // JNZ adr
+		Flags::sync(cpu);
+		JMP_COND(cpu, (opcode[2] << 8) | opcode[1], 0 == cpu->cc.z);
+		NEXT(10);
+
+	op_c3: // JMP adr
+		JMP(cpu, (opcode[2] << 8) | opcode[1]);
+		NEXT(10);
+
+	op_c5: // PUSH B
+		PUSH(cpu, "B");
+		NEXT(11);
+
+	op_c6: // ADI D8
+		ADD<Flags>(cpu, cpu->a, opcode[1], 0);
+		cpu->pc++;
+		NEXT(7);
+
+	op_c8: // RZ
+		Flags::sync(cpu);
+		NEXT(RET_COND(cpu, cpu->cc.z) ? 11 : CYCLES_RET_SKIPPED);
+
+	op_c9: // RET
+		RET(cpu);
+		NEXT(10);
+
+	op_ca: // JZ adr
+		Flags::sync(cpu);
+		JMP_COND(cpu, (opcode[2] << 8) | opcode[1], cpu->cc.z != 0);
+		NEXT(10);
+
+	op_cd: // CALL adr
+		CALL(cpu, (opcode[2] << 8) | opcode[1]);
+		NEXT(17);
+
+	op_d1: // POP D
+		POP(cpu, "D");
+		NEXT(10);
+
+	op_d2: // JNC adr
+		JMP_COND(cpu, (opcode[2] << 8) | opcode[1], cpu->cc.cy == 0);
+		NEXT(10);
+
+	op_d3: // OUT D8
+		OUT(cpu, opcode[1]);
+		NEXT(10);
+
+	op_d5: // PUSH D
+		PUSH(cpu, "D");
+		NEXT(11);
+
+	op_da: // JC adr
+		JMP_COND(cpu, (opcode[2] << 8) | opcode[1], cpu->cc.cy != 0);
+		NEXT(10);
+
+	op_db: // IN D8
+		IN(cpu, opcode[1]);
+		NEXT(10);
+
+	op_e1: // POP H
+		POP(cpu, "H");
+		NEXT(10);
+
+	op_e5: // PUSH H
+		PUSH(cpu, "H");
+		NEXT(11);
+
+	op_e6: // ANI D8
+		ANA<Flags>(cpu, opcode[1]);
+		cpu->pc++;
+		NEXT(7);
+
+	op_eb: // XCHG
+		{ uint8_t save1 = cpu->d;
+		  uint8_t save2 = cpu->e;
+		  cpu->d = cpu->h;
+		  cpu->e = cpu->l;
+		  cpu->h = save1;
+		  cpu->l = save2; }
+		NEXT(5);
+
+	op_f1: // POP PSW
+		POP(cpu, "PSW");
+		NEXT(10);
+
+	op_f5: // PUSH PSW
+		Flags::sync(cpu);
+		PUSH(cpu, "PSW");
+		NEXT(11);
+
+	op_fb: // EI
+		EI(cpu);
+		NEXT(4);
+
+	op_fe: // CPI D8
+		CMP<Flags>(cpu, opcode[1]);
+		cpu->pc++;
+		NEXT(7);
+
+	unimplemented:
+		UnimplementedInstruction(cpu);
+		return i;
+}
+
+#undef NEXT
+#undef DISPATCH
+
+template int cpu_run_threaded<EagerFlags, NoTrace>(CPU* cpu, double cycles);
+template int cpu_run_threaded<LazyFlags, NoTrace>(CPU* cpu, double cycles);
+template int cpu_run_threaded<EagerFlags, CountTrace>(CPU* cpu, double cycles);
+template int cpu_run_threaded<LazyFlags, CountTrace>(CPU* cpu, double cycles);
+template int cpu_run_threaded<EagerFlags, CoverTrace>(CPU* cpu, double cycles);
+template int cpu_run_threaded<LazyFlags, CoverTrace>(CPU* cpu, double cycles);
+
+#else
+
+// Without computed goto (MSVC) there is no threaded core, use the switch.
+
+bool threaded_available() {
+	return false;
+}
+
+template <typename Flags, typename Trace>
+int cpu_run_threaded(CPU* cpu, double cycles) {
+	return cpu_run<Trace, Flags>(cpu, cycles);
+}
+
+template int cpu_run_threaded<EagerFlags, NoTrace>(CPU* cpu, double cycles);
+template int cpu_run_threaded<LazyFlags, NoTrace>(CPU* cpu, double cycles);
+template int cpu_run_threaded<EagerFlags, CountTrace>(CPU* cpu, double cycles);
+template int cpu_run_threaded<LazyFlags, CountTrace>(CPU* cpu, double cycles);
+template int cpu_run_threaded<EagerFlags, CoverTrace>(CPU* cpu, double cycles);
+template int cpu_run_threaded<LazyFlags, CoverTrace>(CPU* cpu, double cycles);
+
+#endif
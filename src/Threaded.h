@@ -0,0 +1,23 @@
+#pragma once
+#include "CPU.h"
+
+// Direct-threaded interpreter core. Needs the computed goto extension of
+// GCC and Clang; elsewhere it falls back to the switch in EmulateI8080_op.
+#if defined(__GNUC__) || defined(__clang__)
+#define I8080_COMPUTED_GOTO
+#endif
+
+/*
+	EFFECTS : returns true when this build has the threaded core
+*/
+
+bool threaded_available();
+
+/*
+	REQUIRES: *cpu is a valid pointer to a CPU data type
+	EFFECTS : Same as cpu_run<Trace, Flags>, using the threaded core. Only
+			  NoTrace, CountTrace and CoverTrace are instantiated.
+*/
+
+template <typename Flags = EagerFlags, typename Trace = NoTrace>
+int cpu_run_threaded(CPU* cpu, double cycles);
@@ -0,0 +1,207 @@
+#include <chrono>
+#include <cstring>
+#include "Trace.h"
+#include "Files.h"
+#include "Disassembler.h"
+
+// Stores record against the one before it into out, returns the bytes used
+static size_t encode(TraceRecord const* record, TraceRecord const* last, uint8_t* out) {
+	uint8_t const* now = (uint8_t const*) &record->state;
+	uint8_t const* before = (uint8_t const*) &last->state;
+	size_t size = 2;
+
+	uint16_t mask = 0;
+	for (int i = 0; i < (int) sizeof(TraceState); i++) {
+		if (now[i] != before[i]) {
+			mask |= 1 << i;
+		}
+	}
+	out[0] = mask & 0xff;
+	out[1] = mask >> 8;
+
+	uint64_t delta = record->cycle - last->cycle;
+	while (delta >= 0x80) {
+		out[size++] = (uint8_t) (delta | 0x80);
+		delta >>= 7;
+	}
+	out[size++] = (uint8_t) delta;
+
+	for (int i = 0; i < (int) sizeof(TraceState); i++) {
+		if (mask & (1 << i)) {
+			out[size++] = now[i];
+		}
+	}
+	return size;
+}
+
+// Encodes and writes what the CPU has added to the ring, returns false when
+// there was nothing
+static bool drain(TraceRing* ring) {
+	uint64_t const tail = ring->tail.load(std::memory_order_relaxed);
+	uint64_t const head = ring->head.load(std::memory_order_acquire);
+	if (tail == head) {
+		return false;
+	}
+
+	// 2 mask bytes, up to 10 varint bytes and 16 state bytes per record
+	static size_t const MAX_RECORD = 2 + 10 + sizeof(TraceState);
+	uint8_t buffer[4096];
+	size_t size = 0;
+	for (uint64_t i = tail; i < head; i++) {
+		TraceRecord const* record = &ring->records[i & (TRACE_RING_SIZE - 1)];
+		size += encode(record, &ring->last, buffer + size);
+		ring->last = *record;
+		if (size > sizeof(buffer) - MAX_RECORD) {
+			fwrite(buffer, 1, size, ring->file);
+			ring->bytes += size;
+			size = 0;
+		}
+	}
+	fwrite(buffer, 1, size, ring->file);
+	ring->bytes += size;
+
+	ring->tail.store(head, std::memory_order_release);
+	return true;
+}
+
+static void writer(TraceRing* ring) {
+	while (true) {
+		bool const closing = ring->closing.load(std::memory_order_acquire);
+		if (!drain(ring)) {
+			if (closing) {
+				return;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
+
+bool trace_open(CPU* cpu, char const* path) {
+	FILE* f = file_open(path, "wb");
+	if (f == NULL) {
+		printf("error: Couldn't create %s\n", path);
+		return false;
+	}
+	fwrite(TRACE_MAGIC, 1, sizeof(TRACE_MAGIC), f);
+
+	TraceRing* ring = new TraceRing();
+	ring->head = 0;
+	ring->tail = 0;
+	ring->closing = false;
+	memset(&ring->next, 0, sizeof(ring->next));
+	ring->room = TRACE_RING_SIZE;
+	ring->stalls = 0;
+	ring->file = f;
+	memset(&ring->last, 0, sizeof(ring->last));
+	ring->bytes = sizeof(TRACE_MAGIC);
+	ring->writer = std::thread(writer, ring);
+
+	cpu->trace = ring;
+	return true;
+}
+
+void trace_close(CPU* cpu) {
+	TraceRing* ring = cpu->trace;
+	if (ring == NULL) {
+		return;
+	}
+
+	ring->closing.store(true, std::memory_order_release);
+	ring->writer.join();
+	fclose(ring->file);
+
+	uint64_t const records = ring->head.load();
+	printf("Traced %llu instructions into %llu bytes (%.1f per instruction), the ring was full %llu times\n",
+		(unsigned long long) records, (unsigned long long) ring->bytes,
+		records > 0 ? (double) ring->bytes / records : 0.0, (unsigned long long) ring->stalls);
+
+	delete ring;
+	cpu->trace = NULL;
+}
+
+void trace_wait_room(CPU* cpu) {
+	TraceRing* ring = cpu->trace;
+	uint64_t const head = ring->head.load(std::memory_order_relaxed);
+	while (true) {
+		ring->room = ring->tail.load(std::memory_order_acquire) + TRACE_RING_SIZE;
+		if (head < ring->room) {
+			return;
+		}
+		ring->stalls++;
+		std::this_thread::yield();
+	}
+}
+
+bool trace_reader_open(TraceReader* reader, char const* path) {
+	reader->file = file_open(path, "rb");
+	if (reader->file == NULL) {
+		printf("error: Couldn't open %s\n", path);
+		return false;
+	}
+
+	char magic[sizeof(TRACE_MAGIC)];
+	if (fread(magic, 1, sizeof(magic), reader->file) != sizeof(magic) || memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0) {
+		printf("error: %s is not a trace\n", path);
+		fclose(reader->file);
+		return false;
+	}
+
+	memset(&reader->last, 0, sizeof(reader->last));
+	return true;
+}
+
+bool trace_reader_next(TraceReader* reader, TraceRecord* record) {
+	int const low = fgetc(reader->file);
+	int const high = fgetc(reader->file);
+	if (low == EOF || high == EOF) {
+		return false;
+	}
+	uint16_t const mask = (uint16_t) (low | (high << 8));
+
+	uint64_t delta = 0;
+	for (int shift = 0; ; shift += 7) {
+		int const byte = fgetc(reader->file);
+		if (byte == EOF) {
+			return false;
+		}
+		delta |= (uint64_t) (byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			break;
+		}
+	}
+
+	*record = reader->last;
+	record->cycle += delta;
+	uint8_t* state = (uint8_t*) &record->state;
+	for (int i = 0; i < (int) sizeof(TraceState); i++) {
+		if (mask & (1 << i)) {
+			int const byte = fgetc(reader->file);
+			if (byte == EOF) {
+				return false;
+			}
+			state[i] = (uint8_t) byte;
+		}
+	}
+
+	reader->last = *record;
+	return true;
+}
+
+void trace_reader_close(TraceReader* reader) {
+	fclose(reader->file);
+}
+
+void trace_print(TraceRecord const* record) {
+	TraceState const& state = record->state;
+	printf("Cycles: %llu\n", (unsigned long long) record->cycle);
+
+	// The disassembler reads the instruction at its address
+	static uint8_t code[0x10002];
+	memcpy(&code[state.pc], state.op, 3);
+	disassemble_8080_op_code(code, state.pc);
+
+	printf("\t%c%c%c%c%c  ", (state.flags & TRACE_Z) ? 'z' : '.', (state.flags & TRACE_S) ? 's' : '.',
+		(state.flags & TRACE_P) ? 'p' : '.', (state.flags & TRACE_CY) ? 'c' : '.', (state.flags & TRACE_AC) ? 'a' : '.');
+	printf("A $%02x B $%02x C $%02x D $%02x E $%02x H $%02x L $%02x SP %04x\n", state.a, state.b, state.c,
+		state.d, state.e, state.h, state.l, state.sp);
+}
@@ -0,0 +1,165 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include "CPU.h"
+
+// Binary instruction trace. RingTrace is a trace policy like PrintTrace, but
+// each instruction only becomes a 24 byte record in a ring buffer owned by
+// the CPU. A writer thread empties the ring into a file, every record stored
+// as the bytes that differ from the record before it, so the interpreter
+// runs close to full speed. tools/tracedump.cpp prints a trace file the way
+// PrintTrace would have.
+//
+// Trace file: the 8 bytes of TRACE_MAGIC, then per record a 16 bit mask of
+// the bytes of TraceState that changed (low byte first), the cycle
+// delta as a base 128 varint (low 7 bits first), and the changed bytes.
+
+char const TRACE_MAGIC[8] = { 'I', '8', '0', '8', '0', 'T', 'R', '1' };
+size_t const TRACE_RING_SIZE = 1 << 16; // records, a power of two
+
+// Flag bits in TraceState::flags
+uint8_t const TRACE_Z = 0x01;
+uint8_t const TRACE_S = 0x02;
+uint8_t const TRACE_P = 0x04;
+uint8_t const TRACE_CY = 0x08;
+uint8_t const TRACE_AC = 0x10;
+
+// What a record stores against the record before it, byte by byte
+struct TraceState {
+	uint16_t pc; // of the instruction
+	uint16_t sp; // after it
+	uint8_t op[3]; // its bytes, those past its length included
+	uint8_t flags; // after it
+	uint8_t a, b, c, d, e, h, l; // after it
+	uint8_t pad;
+};
+
+static_assert(sizeof(TraceState) == 16, "one mask bit per byte");
+
+struct TraceRecord {
+	uint64_t cycle; // cycles run before the instruction
+	TraceState state;
+};
+
+struct TraceRing {
+	TraceRecord records[TRACE_RING_SIZE];
+	std::atomic<uint64_t> head; // records the CPU added
+	std::atomic<uint64_t> tail; // records the writer took
+	std::atomic<bool> closing;
+
+	// CPU side
+	TraceRecord next; // the instruction being run
+	uint64_t room; // head may go up to this without looking at tail
+	uint64_t stalls; // times the ring was full
+
+	// Writer side
+	std::thread writer;
+	FILE* file;
+	TraceRecord last; // the record the next one is stored against
+	uint64_t bytes; // written to file
+};
+
+/*
+	REQUIRES: cpu->trace is NULL
+	Modifies: cpu->trace
+	EFFECTS : creates the trace file at path and starts its writer, then
+			  RingTrace records every instruction cpu runs. Returns false
+			  after printing an error if the file can't be created.
+*/
+
+bool trace_open(CPU* cpu, char const* path);
+
+/*
+	Modifies: cpu->trace
+	EFFECTS : writes out what is left in the ring, stops the writer, closes
+			  the file and prints the records and bytes written. Does
+			  nothing if cpu isn't traced.
+*/
+
+void trace_close(CPU* cpu);
+
+/*
+	REQUIRES: only the CPU's thread calls this
+	Modifies: cpu->trace
+	EFFECTS : waits for the writer until the ring has room again
+*/
+
+void trace_wait_room(CPU* cpu);
+
+// The trace policy: instruction takes pc and the opcode, registers the state
+// the instruction left and hands the record to the ring
+struct RingTrace {
+	static void instruction(CPU* const cpu) {
+		TraceRecord* const record = &cpu->trace->next;
+		record->state.pc = cpu->pc;
+		record->state.op[0] = CPU_read(cpu, cpu->pc);
+		record->state.op[1] = CPU_read(cpu, cpu->pc + 1);
+		record->state.op[2] = CPU_read(cpu, cpu->pc + 2);
+	}
+
+	static void registers(CPU* const cpu, int const cycles) {
+		TraceRing* const ring = cpu->trace;
+		CPU_sync_flags(cpu);
+		TraceRecord* const record = &ring->next;
+		record->state.sp = cpu->sp;
+		record->state.flags = (cpu->cc.z ? TRACE_Z : 0) | (cpu->cc.s ? TRACE_S : 0) | (cpu->cc.p ? TRACE_P : 0)
+			| (cpu->cc.cy ? TRACE_CY : 0) | (cpu->cc.ac ? TRACE_AC : 0);
+		record->state.a = cpu->a;
+		record->state.b = cpu->b;
+		record->state.c = cpu->c;
+		record->state.d = cpu->d;
+		record->state.e = cpu->e;
+		record->state.h = cpu->h;
+		record->state.l = cpu->l;
+
+		uint64_t const head = ring->head.load(std::memory_order_relaxed);
+		if (head == ring->room) {
+			trace_wait_room(cpu);
+		}
+		ring->records[head & (TRACE_RING_SIZE - 1)] = *record;
+		ring->head.store(head + 1, std::memory_order_release);
+		record->cycle += cycles;
+	}
+
+	static void cycles(int) {}
+};
+
+// Reads a trace file back, one record at a time
+struct TraceReader {
+	FILE* file;
+	TraceRecord last;
+};
+
+/*
+	Modifies: *reader
+	EFFECTS : opens the trace file at path, returns false after printing an
+			  error if it can't be read or isn't a trace
+*/
+
+bool trace_reader_open(TraceReader* reader, char const* path);
+
+/*
+	Modifies: *reader, *record
+	EFFECTS : reads the next record into record, returns false at the end
+			  of the file
+*/
+
+bool trace_reader_next(TraceReader* reader, TraceRecord* record);
+
+/*
+	Modifies: *reader
+	EFFECTS : closes the file
+*/
+
+void trace_reader_close(TraceReader* reader);
+
+/*
+	EFFECTS : prints record like PrintTrace: the cycle stamp, the
+			  disassembled instruction and the registers after it. The
+			  stamp counts from the start of the run, PrintTrace's from
+			  the start of each cpu_run.
+*/
+
+void trace_print(TraceRecord const* record);
@@ -0,0 +1,96 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "Verify.h"
+#include "Flags.h"
+
+// Flags as they would read after a sync, without touching the CPU itself.
+// Runs twice an instruction in lockstep, so only the flags are copied.
+static ConditionCodes current_flags(CPU const* cpu) {
+	ConditionCodes cc = cpu->cc;
+	PendingFlags const& pending = cpu->pending;
+	if (pending.kind != FLAGS_NONE) {
+		set_zspac(&cc, pending.kind, pending.a, pending.val, pending.res);
+	}
+	return cc;
+}
+
+bool CPU_same_registers(CPU const* a, CPU const* b) {
+	ConditionCodes fa = current_flags(a);
+	ConditionCodes fb = current_flags(b);
+
+	return a->a == b->a && a->b == b->b && a->c == b->c &&
+		a->d == b->d && a->e == b->e && a->h == b->h && a->l == b->l &&
+		a->sp == b->sp && a->pc == b->pc && a->int_enable == b->int_enable &&
+		fa.z == fb.z && fa.s == fb.s && fa.p == fb.p && fa.cy == fb.cy && fa.ac == fb.ac;
+}
+
+void CPU_print_state(char const* name, CPU const* cpu) {
+	ConditionCodes cc = current_flags(cpu);
+	printf("%-8s PC %04x ", name, cpu->pc);
+	printf("%c", cc.z ? 'z' : '.');
+	printf("%c", cc.s ? 's' : '.');
+	printf("%c", cc.p ? 'p' : '.');
+	printf("%c", cc.cy ? 'c' : '.');
+	printf("%c  ", cc.ac ? 'a' : '.');
+	printf("A $%02x B $%02x C $%02x D $%02x E $%02x H $%02x L $%02x SP %04x\n", cpu->a, cpu->b, cpu->c,
+		cpu->d, cpu->e, cpu->h, cpu->l, cpu->sp);
+}
+
+long verify_lazy_flags(CPU const* cpu, int frames) {
+	CPU* eager = CPU_clone(cpu);
+	CPU* lazy = CPU_clone(cpu);
+	if (eager == NULL || lazy == NULL) {
+		if (eager != NULL) {
+			CPU_free(eager);
+		}
+		if (lazy != NULL) {
+			CPU_free(lazy);
+		}
+		return -1;
+	}
+	long steps = 0;
+	bool same = true;
+
+	for (int frame = 0; frame < frames && same; frame++) {
+		for (int half = 0; half < 2 && same; half++) {
+			int i = 0;
+			while (i < CYCLES_PER_TIC / 2) {
+				uint16_t pc = eager->pc;
+				int cycles = EmulateI8080_op<NoTrace, EagerFlags>(eager);
+				int lazy_cycles = EmulateI8080_op<NoTrace, LazyFlags>(lazy);
+
+				// Memory is only compared every so often, the registers every step
+				if (cycles != lazy_cycles || !CPU_same_registers(eager, lazy) ||
+					((steps & 0xfff) == 0 && memcmp(eager->memory, lazy->memory, 0x10000) != 0)) {
+					printf("Lazy flags differ after instruction %ld at %04x (frame %d)\n", steps, pc, frame);
+					CPU_print_state("eager", eager);
+					CPU_print_state("lazy", lazy);
+					same = false;
+					break;
+				}
+
+				i += cycles;
+				steps++;
+			}
+
+			if (same && memcmp(eager->memory, lazy->memory, 0x10000) != 0) {
+				printf("Lazy flags: memory differs at the end of frame %d\n", frame);
+				same = false;
+			}
+
+			int interrupt = half == 0 ? 0x08 : 0x10;
+			if (eager->int_enable) {
+				generate_interrupt(eager, interrupt);
+			}
+			if (lazy->int_enable) {
+				generate_interrupt(lazy, interrupt);
+			}
+		}
+	}
+
+	CPU_free(eager);
+	CPU_free(lazy);
+
+	return same ? steps : -1;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "CPU.h"
+
+/*
+	REQUIRES: *cpu is a valid pointer to a CPU with a program in memory
+	EFFECTS : Runs one copy of *cpu with EagerFlags and one with LazyFlags
+			  in lockstep for frames frames, raising interrupts the way main()
+			  does, and compares them after every instruction. Returns the
+			  number of instructions that matched, or -1 after printing both
+			  states at the first difference or when the copies can't be
+			  made.
+*/
+
+long verify_lazy_flags(CPU const* cpu, int frames);
+
+/*
+	EFFECTS : returns true when both CPUs have the same registers and flags,
+			  reading flags a LazyFlags core has not written yet
+*/
+
+bool CPU_same_registers(CPU const* a, CPU const* b);
+
+/*
+	EFFECTS : prints the registers and flags of *cpu after name
+*/
+
+void CPU_print_state(char const* name, CPU const* cpu);
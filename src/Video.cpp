@@ -0,0 +1,241 @@
+#include <cstddef>
+#include <cstring>
+#include "Video.h"
+#include "Bus.h"
+
+#if defined(I8080_VIDEO_AVX2) || defined(I8080_VIDEO_SSE2)
+#include <immintrin.h>
+#endif
+
+// Offset into VRAM that a store to address lands on, or -1 when it misses.
+// The page's write target already accounts for mirrors.
+static int vram_offset(CPU const* cpu, uint16_t const address) {
+	ptrdiff_t const offset = cpu->write_target[address >> 8] + (address & 0xff) - (cpu->memory + VRAM_START);
+	return offset >= 0 && offset < VRAM_SIZE ? (int) offset : -1;
+}
+
+static void mark_store(CPU* cpu, uint16_t address, uint8_t val, void* user) {
+	VideoDirty* dirty = (VideoDirty*) user;
+	int const offset = vram_offset(cpu, address);
+	if (offset >= 0) {
+		int const column = offset / VRAM_COLUMN_BYTES;
+		dirty->columns[column >> 5] |= 1u << (column & 31);
+	}
+}
+
+// Whether stores to page can reach VRAM
+static bool page_hits_vram(CPU const* cpu, int const page) {
+	uint8_t const* const target = cpu->write_target[page];
+	return target + 0x100 > cpu->memory + VRAM_START && target < cpu->memory + VRAM_START + VRAM_SIZE;
+}
+
+void video_dirty_attach(CPU* cpu, VideoDirty* dirty) {
+	video_dirty_mark_all(dirty);
+	for (int page = 0; page < 256; page++) {
+		if (page_hits_vram(cpu, page)) {
+			bus_set_hook(cpu, page, mark_store, dirty);
+		}
+	}
+}
+
+void video_dirty_detach(CPU* cpu) {
+	for (int page = 0; page < 256; page++) {
+		if (cpu->hooks != NULL && cpu->hooks->write[page] == mark_store) {
+			bus_set_hook(cpu, page, NULL, NULL);
+		}
+	}
+}
+
+bool video_dirty_any(VideoDirty const* dirty) {
+	uint32_t any = 0;
+	for (uint32_t const word : dirty->columns) {
+		any |= word;
+	}
+	return any != 0;
+}
+
+// First column at or after column whose bit is set in words, xored with flip
+static int next_column(uint32_t const* words, uint32_t const flip, int column) {
+	while (column < VRAM_COLUMNS) {
+		uint32_t const word = (words[column >> 5] ^ flip) >> (column & 31);
+		if (word != 0) {
+			int skip = 0;
+			while (!((word >> skip) & 1)) {
+				skip++;
+			}
+			return column + skip;
+		}
+		column = (column | 31) + 1;
+	}
+	return VRAM_COLUMNS;
+}
+
+int video_dirty_next(VideoDirty const* dirty, int const column) {
+	return next_column(dirty->columns, 0, column);
+}
+
+int video_dirty_next_clean(VideoDirty const* dirty, int const column) {
+	return next_column(dirty->columns, ~0u, column);
+}
+
+void video_dirty_mark_all(VideoDirty* dirty) {
+	memset(dirty->columns, 0xff, sizeof(dirty->columns));
+}
+
+void video_dirty_clear(VideoDirty* dirty) {
+	memset(dirty->columns, 0, sizeof(dirty->columns));
+}
+
+bool video_dirty_move(VideoDirty* from, VideoDirty* to, int const first, int const end) {
+	uint32_t moved = 0;
+	for (int column = first; column < end; column++) {
+		uint32_t const bit = 1u << (column & 31);
+		uint32_t const mark = from->columns[column >> 5] & bit;
+		from->columns[column >> 5] &= ~bit;
+		to->columns[column >> 5] |= mark;
+		moved |= mark;
+	}
+	return moved != 0;
+}
+
+void video_palette_mono(VideoPalette* palette, uint32_t const color) {
+	for (int y = 0; y < SCREEN_HEIGHT; y++) {
+		for (int group = 0; group < SCREEN_WIDTH / 8; group++) {
+			palette->color[y][group] = color;
+		}
+	}
+}
+
+void video_palette_overlay(VideoPalette* palette) {
+	uint32_t const red = 0xff2020;
+	uint32_t const green = 0x20ff20;
+
+	video_palette_mono(palette, 0xffffff);
+	for (int y = 0; y < SCREEN_HEIGHT; y++) {
+		for (int group = 0; group < SCREEN_WIDTH / 8; group++) {
+			int const x = group * 8;
+			if (y >= 32 && y < 64) {
+				palette->color[y][group] = red;
+			}
+			else if (y >= 184 && y < 240) {
+				palette->color[y][group] = green;
+			}
+			else if (y >= 240 && x >= 16 && x < 136) {
+				palette->color[y][group] = green;
+			}
+		}
+	}
+}
+
+// Expansion kernels. VRAM runs bottom to top up each screen column, so a
+// tile of 8 columns by 8 rows is byte k of 8 neighbouring columns. Turning
+// it on its side makes each byte one screen row of 8 pixels, which a kernel
+// writes out as 8 pixels at once, the bits masking the row's colour.
+
+// 8x8 bit transpose: bit j of byte i moves to bit i of byte j
+static uint64_t transpose8(uint64_t x) {
+	uint64_t t;
+	t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaull;
+	x = x ^ t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000cccc0000ccccull;
+	x = x ^ t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ull;
+	x = x ^ t ^ (t << 28);
+	return x;
+}
+
+// Each bit of a byte as a whole pixel mask, lowest bit leftmost
+struct ScalarKernel {
+	static uint32_t const (&masks())[256][8] {
+		static uint32_t table[256][8];
+		static bool const filled = [] {
+			for (int bits = 0; bits < 256; bits++) {
+				for (int x = 0; x < 8; x++) {
+					table[bits][x] = (bits >> x) & 1 ? 0xffffffff : 0;
+				}
+			}
+			return true;
+		}();
+		(void) filled;
+		return table;
+	}
+
+	static void row(uint32_t const bits, uint32_t const color, uint32_t* const dst) {
+		uint32_t const* const mask = masks()[bits];
+		for (int x = 0; x < 8; x++) {
+			dst[x] = mask[x] & color;
+		}
+	}
+};
+
+#ifdef I8080_VIDEO_SSE2
+struct Sse2Kernel {
+	static void row(uint32_t const bits, uint32_t const color, uint32_t* const dst) {
+		__m128i const lo = _mm_setr_epi32(1, 2, 4, 8);
+		__m128i const hi = _mm_setr_epi32(16, 32, 64, 128);
+		__m128i const v = _mm_set1_epi32((int) bits);
+		__m128i const c = _mm_set1_epi32((int) color);
+		_mm_storeu_si128((__m128i*) dst, _mm_and_si128(_mm_cmpeq_epi32(_mm_and_si128(v, lo), lo), c));
+		_mm_storeu_si128((__m128i*) (dst + 4), _mm_and_si128(_mm_cmpeq_epi32(_mm_and_si128(v, hi), hi), c));
+	}
+};
+#endif
+
+#ifdef I8080_VIDEO_AVX2
+struct Avx2Kernel {
+	static void row(uint32_t const bits, uint32_t const color, uint32_t* const dst) {
+		__m256i const each = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+		__m256i const v = _mm256_set1_epi32((int) bits);
+		__m256i const lit = _mm256_cmpeq_epi32(_mm256_and_si256(v, each), each);
+		_mm256_storeu_si256((__m256i*) dst, _mm256_and_si256(lit, _mm256_set1_epi32((int) color)));
+	}
+};
+#endif
+
+// Tiles go a band of 8 screen rows at a time, so stores run along rows
+template <typename Kernel>
+static void expand(uint8_t const* vram, uint32_t* pixels, int const pitch, VideoPalette const* palette, int const first, int const end) {
+	int const first_group = first >> 3;
+	int const end_group = (end + 7) >> 3;
+
+	for (int k = 0; k < VRAM_COLUMN_BYTES; k++) {
+		for (int group = first_group; group < end_group; group++) {
+			uint8_t const* const src = vram + group * 8 * VRAM_COLUMN_BYTES + k;
+			uint64_t tile = 0;
+			for (int col = 0; col < 8; col++) {
+				tile |= (uint64_t) src[col * VRAM_COLUMN_BYTES] << (8 * col);
+			}
+			tile = transpose8(tile);
+
+			// Bit j of byte k is screen row 255 - 8k - j
+			for (int j = 0; j < 8; j++) {
+				int const y = SCREEN_HEIGHT - 1 - 8 * k - j;
+				Kernel::row((uint32_t) (tile >> (8 * j)) & 0xff, palette->color[y][group], pixels + y * pitch + group * 8);
+			}
+		}
+	}
+}
+
+char const* video_expand_kernel() {
+#if defined(I8080_VIDEO_AVX2)
+	return "avx2";
+#elif defined(I8080_VIDEO_SSE2)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
+
+void video_expand(uint8_t const* vram, uint32_t* pixels, int const pitch, VideoPalette const* palette, int const first, int const end) {
+#if defined(I8080_VIDEO_AVX2)
+	expand<Avx2Kernel>(vram, pixels, pitch, palette, first, end);
+#elif defined(I8080_VIDEO_SSE2)
+	expand<Sse2Kernel>(vram, pixels, pitch, palette, first, end);
+#else
+	expand<ScalarKernel>(vram, pixels, pitch, palette, first, end);
+#endif
+}
+
+void video_expand_scalar(uint8_t const* vram, uint32_t* pixels, int const pitch, VideoPalette const* palette, int const first, int const end) {
+	expand<ScalarKernel>(vram, pixels, pitch, palette, first, end);
+}
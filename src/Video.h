@@ -0,0 +1,135 @@
+#pragma once
+#include <cstdint>
+#include "CPU.h"
+
+// The Space Invaders frame buffer, which parts of it changed, and how it
+// turns into pixels. VRAM is 224 columns of 32 bytes, each column one 256
+// pixel line of the rotated screen. Stores reach VRAM through bus hooks (see
+// bus_set_hook), which mark the column they hit, so a renderer only converts
+// what changed and a frame with no stores costs nothing.
+
+// Widest expansion kernel the build target allows, picked at compile time
+// (-mavx2 or /arch:AVX2 for AVX2). Other hosts use a lookup table.
+#if defined(__AVX2__)
+#define I8080_VIDEO_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define I8080_VIDEO_SSE2
+#endif
+
+uint16_t const VRAM_START = 0x2400;
+uint16_t const VRAM_SIZE = 0x1c00; // 224 columns of 256 pixels, 1 bit each
+int const VRAM_COLUMNS = 224;
+int const VRAM_COLUMN_BYTES = 32;
+
+// The upright screen
+int const SCREEN_WIDTH = VRAM_COLUMNS;
+int const SCREEN_HEIGHT = 256;
+
+// Colour of the lit pixels in every run of 8 screen pixels, unlit ones are
+// black. The kernels mask the colour with the bits, so an overlay is free.
+struct VideoPalette {
+	uint32_t color[SCREEN_HEIGHT][SCREEN_WIDTH / 8];
+};
+
+// Columns stored to since the last video_dirty_clear, one bit each
+struct VideoDirty {
+	uint32_t columns[VRAM_COLUMNS / 32];
+};
+
+/*
+	REQUIRES: cpu's memory map is set up, dirty outlives the hooks
+	Modifies: *dirty, cpu->hooks
+	EFFECTS : marks every column of dirty, then has every store that
+			  reaches VRAM, through any mirror, mark its column
+*/
+
+void video_dirty_attach(CPU* cpu, VideoDirty* dirty);
+
+/*
+	Modifies: cpu->hooks
+	EFFECTS : stops the stores of *cpu marking any VideoDirty
+*/
+
+void video_dirty_detach(CPU* cpu);
+
+/*
+	EFFECTS : returns true if any column is marked
+*/
+
+bool video_dirty_any(VideoDirty const* dirty);
+
+/*
+	EFFECTS : returns the first marked column at or after column, or
+			  VRAM_COLUMNS if there is none
+*/
+
+int video_dirty_next(VideoDirty const* dirty, int column);
+
+/*
+	EFFECTS : returns the first unmarked column at or after column, or
+			  VRAM_COLUMNS if there is none
+*/
+
+int video_dirty_next_clean(VideoDirty const* dirty, int column);
+
+/*
+	Modifies: *dirty
+	EFFECTS : marks every column
+*/
+
+void video_dirty_mark_all(VideoDirty* dirty);
+
+/*
+	Modifies: *dirty
+	EFFECTS : unmarks every column
+*/
+
+void video_dirty_clear(VideoDirty* dirty);
+
+/*
+	REQUIRES: 0 <= first <= end <= VRAM_COLUMNS
+	Modifies: *from, *to
+	EFFECTS : moves the marks of columns first to end - 1 from from to to,
+			  returns true if there were any
+*/
+
+bool video_dirty_move(VideoDirty* from, VideoDirty* to, int first, int end);
+
+/*
+	Modifies: *palette
+	EFFECTS : lights every pixel in color, 0xRRGGBB
+*/
+
+void video_palette_mono(VideoPalette* palette, uint32_t color);
+
+/*
+	Modifies: *palette
+	EFFECTS : the cabinet's gels: red over the flying saucer band, green
+			  over the player, the shields and the lives, white elsewhere
+*/
+
+void video_palette_overlay(VideoPalette* palette);
+
+/*
+	EFFECTS : returns the name of the kernel video_expand uses
+*/
+
+char const* video_expand_kernel();
+
+/*
+	REQUIRES: vram holds VRAM_SIZE bytes, pixels SCREEN_HEIGHT rows of pitch
+			  pixels with pitch >= SCREEN_WIDTH, 0 <= first <= end <=
+			  SCREEN_WIDTH
+	Modifies: pixels
+	EFFECTS : draws screen columns first to end - 1 upright into pixels, in
+			  palette's colours. Works in tiles 8 columns wide, so up to 7
+			  columns on either side are redrawn too.
+*/
+
+void video_expand(uint8_t const* vram, uint32_t* pixels, int pitch, VideoPalette const* palette, int first, int end);
+
+/*
+	EFFECTS : same as video_expand, always with the lookup table kernel
+*/
+
+void video_expand_scalar(uint8_t const* vram, uint32_t* pixels, int pitch, VideoPalette const* palette, int first, int end);
@@ -6,32 +6,31 @@ std::string const TITLE = "Space Invaders";
 int const HEIGHT = 256;
 int const WIDTH = 224;
 
-// Globals
-
-SDL_Surface* surf;
-int resizef;
-SDL_Window* win;
-SDL_Surface* winsurf;
-
-int HandleResize(void* userdata, SDL_Event* ev) {
-	if (ev->type == SDL_WINDOWEVENT) {
+int HandleWindowEvent(void* userdata, SDL_Event* ev) {
+	Display* display = (Display*) userdata;
+	if (ev->type == SDL_WINDOWEVENT && ev->window.windowID == SDL_GetWindowID(display->win)) {
 		if (ev->window.event == SDL_WINDOWEVENT_RESIZED) {
-			resizef = 1;
+			display->resizef = 1;
+		}
+		if (ev->window.event == SDL_WINDOWEVENT_EXPOSED) {
+			display->exposef = 1;
 		}
 	}
 
 	return 0;  // Ignored
 }
 
-void display_init() {
+Display* display_init() {
 	// Init SDL
-	if (SDL_Init(SDL_INIT_VIDEO)) {
+	if (!SDL_WasInit(SDL_INIT_VIDEO) && SDL_Init(SDL_INIT_VIDEO)) {
 		printf("%s\n", SDL_GetError());
 		exit(1);
 	}
 
+	Display* display = new Display();
+
 	// Create a window
-	win = SDL_CreateWindow(
+	SDL_Window* win = SDL_CreateWindow(
 		TITLE.c_str(),
 		SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
 		2*WIDTH, 2*HEIGHT, SDL_WINDOW_SHOWN
@@ -41,54 +40,93 @@ void display_init() {
 		exit(1);
 	}
 
+	display->win = win;
+
 	// Get surface
-	winsurf = SDL_GetWindowSurface(win);
-	if (!winsurf) {
+	display->winsurf = SDL_GetWindowSurface(win);
+	if (!display->winsurf) {
 		puts("Failed to get surface");
 		assert(false);
 	}
 
-	// Handle resize events
-	SDL_AddEventWatch(HandleResize, NULL);
+	// Handle resize and expose events
+	SDL_AddEventWatch(HandleWindowEvent, display);
 
 	// Create backbuffer surface
-	surf = SDL_CreateRGBSurface(0, WIDTH, HEIGHT, 32, 0, 0, 0, 0);
+	display->surf = SDL_CreateRGBSurface(0, WIDTH, HEIGHT, 32, 0, 0, 0, 0);
+	video_palette_mono(&display->palette, 0xFFFFFF);
+	return display;
 }
 
-void draw_video_ram(uint8_t *memory) {
-	uint32_t* pix = (uint32_t*) surf->pixels;
-
-	int i = 0x2400;  // Start of Video RAM
-	for (int col = 0; col < WIDTH; col++) {
-		for (int row = HEIGHT; row > 0; row -= 8) {
-			for (int j = 0; j < 8; j++) {
-				int idx = (row - j) * WIDTH + col;
-
-				if (memory[i] & 1 << j) {
-					pix[idx] = 0xFFFFFF;
-				}
-				else {
-					pix[idx] = 0x000000;
-				}
-			}
+void display_free(Display* display) {
+	SDL_DelEventWatch(HandleWindowEvent, display);
+	SDL_FreeSurface(display->surf);
+	SDL_DestroyWindow(display->win);
+	delete display;
+}
 
-			i++;
-		}
+void draw_video_ram(Display* display, uint8_t const* vram, VideoDirty* dirty) {
+	// The kernel draws whole tiles of 8 columns, so spans are rounded to them
+	for (int column = video_dirty_next(dirty, 0); column < VRAM_COLUMNS; ) {
+		int const first = column & ~7;
+		int end = (video_dirty_next_clean(dirty, column) + 7) & ~7;
+		end = end < VRAM_COLUMNS ? end : VRAM_COLUMNS;
+		video_expand(vram, (uint32_t*) display->surf->pixels, display->surf->pitch / 4, &display->palette, first, end);
+		column = video_dirty_next(dirty, end);
+	}
+
+	show_video(display, dirty);
+}
+
+void show_video(Display* display, VideoDirty* dirty) {
+	if (display->resizef) {
+		display->winsurf = SDL_GetWindowSurface(display->win);
+		display->resizef = 0;
+		display->exposef = 1;
 	}
 
-	if (resizef) {
-		winsurf = SDL_GetWindowSurface(win);
+	bool const whole = display->exposef != 0;
+	if (!whole && !video_dirty_any(dirty)) {
+		return;  // The window already shows this frame
 	}
 
-	SDL_BlitScaled(surf, NULL, winsurf, NULL);
+	// Dirty columns go out as spans, each its own strip of the window
+	SDL_Rect rects[VRAM_COLUMNS / 8];
+	int count = 0;
+	for (int column = video_dirty_next(dirty, 0); column < VRAM_COLUMNS && !whole; ) {
+		int const first = column & ~7;
+		int end = (video_dirty_next_clean(dirty, column) + 7) & ~7;
+		end = end < VRAM_COLUMNS ? end : VRAM_COLUMNS;
+
+		SDL_Rect src = { first, 0, end - first, HEIGHT };
+		SDL_Rect dst;
+		dst.x = first * display->winsurf->w / WIDTH;
+		dst.y = 0;
+		dst.w = end * display->winsurf->w / WIDTH - dst.x;
+		dst.h = display->winsurf->h;
+		SDL_BlitScaled(display->surf, &src, display->winsurf, &dst);
+		rects[count++] = dst;
+
+		column = video_dirty_next(dirty, end);
+	}
+	video_dirty_clear(dirty);
 
 	// Update window
-	if (SDL_UpdateWindowSurface(win)) {
+	int failed;
+	if (whole) {
+		SDL_BlitScaled(display->surf, NULL, display->winsurf, NULL);
+		failed = SDL_UpdateWindowSurface(display->win);
+		display->exposef = 0;
+	}
+	else {
+		failed = SDL_UpdateWindowSurfaceRects(display->win, rects, count);
+	}
+	if (failed) {
 		puts(SDL_GetError());
 	}
 }
 
-void handle_input(uint8_t *ports) {
+bool handle_input(uint8_t *ports) {
 	SDL_Event ev;
 	while (SDL_PollEvent(&ev)) {
 		switch (ev.type) {
@@ -155,14 +193,14 @@ void handle_input(uint8_t *ports) {
 				break;
 
 			case 'q':  // Quit
-				exit(0);
-				break;
+				return false;
 			}
 			break;
 
 		case SDL_QUIT:
-			exit(0);
-			break;
+			return false;
 		}
 	}
-}
\ No newline at end of file
+
+	return true;
+}
\ No newline at end of file
@@ -1,9 +1,43 @@
 #pragma once
 #include "SDL.h"
 #include <string>
+#include "Video.h"
 
-void display_init();
+// One window showing one machine's video RAM
+struct Display {
+	SDL_Window* win;
+	SDL_Surface* winsurf;
+	SDL_Surface* surf; // backbuffer at the cabinet's resolution
+	int resizef; // set when the window was resized and winsurf is stale
+	int exposef; // set when the window lost what it showed
+	VideoPalette palette; // colours of the lit pixels, white to start with
+};
 
-void handle_input(uint8_t* ports);
+Display* display_init();
 
-void draw_video_ram(uint8_t* memory);
\ No newline at end of file
+void display_free(Display* display);
+
+/*
+	Modifies: ports[1], ports[2]
+	EFFECTS : applies the pending key events to the input ports, returns
+			  false once the window was closed or q was pressed
+*/
+
+bool handle_input(uint8_t* ports);
+
+/*
+	Modifies: *dirty
+	EFFECTS : converts the columns of vram (VRAM_SIZE bytes) marked in
+			  dirty and shows them, then clears dirty. When nothing is marked
+			  and the window still shows the last frame, it does nothing.
+*/
+
+void draw_video_ram(Display* display, uint8_t const* vram, VideoDirty* dirty);
+
+/*
+	Modifies: *dirty
+	EFFECTS : shows the columns of the backbuffer marked in dirty, which
+			  have been drawn already, then clears dirty
+*/
+
+void show_video(Display* display, VideoDirty* dirty);
@@ -0,0 +1,525 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "CPU.h"
+#include "Threaded.h"
+#include "BlockCache.h"
+#include "Jit.h"
+#include "Aot.h"
+#include "Idle.h"
+#include "Machine.h"
+#include "Bus.h"
+#include "Headless.h"
+#include "Batch.h"
+#include "Verify.h"
+#include "Pacer.h"
+#include "Trace.h"
+#include "OpCounts.h"
+#include "Profiler.h"
+
+// aot_init as a batch engine setup
+static void aot_setup(CPU* cpu) {
+	aot_init(cpu);
+}
+
+// Writes the counts of a --count-ops run to path
+static bool dump_counts(CPU const* cpu, char const* path) {
+	if (cpu->counts == NULL) {
+		return true;
+	}
+	printf("Counted %llu instructions into %s\n", (unsigned long long) op_counts_total(cpu->counts), path);
+	return op_counts_dump(cpu->counts, path);
+}
+
+// Prints the report of a --profile run
+static void report_profile(Machine const* machine) {
+	if (machine->profile != NULL) {
+		profile_report(machine->profile, machine->cpu, 20);
+		delete machine->profile;
+	}
+}
+
+#ifndef I8080_HEADLESS
+#include <atomic>
+#include "display.h"
+#include "Frames.h"
+
+// Windowed front end, the user of the machine's hooks. With a render thread
+// the machine runs on its own thread and only hands over VRAM snapshots; the
+// main thread, which owns the window, draws them and reads the keyboard.
+struct Window {
+	Display* display;
+	VideoDirty dirty; // VRAM columns stored to since the last frame shown
+	Pacer pacer;
+	FrameExchange* frames; // NULL when the machine's thread draws
+	bool beam; // columns are taken as the beam passes them
+	VideoDirty shown; // with beam, columns taken since the last frame shown
+	uint8_t beam_vram[VRAM_SIZE]; // with beam and frames, VRAM as the beam saw it
+	std::atomic<uint16_t> controls; // ports 1 and 2 from the render thread
+	std::atomic<bool> running;
+};
+
+static void window_input(Machine* machine) {
+	Window* window = (Window*) machine->hooks.user;
+	if (window->frames == NULL) {
+		if (!handle_input(machine->cpu->ports)) {
+			window->running = false;
+		}
+		return;
+	}
+
+	uint16_t const controls = window->controls.load(std::memory_order_relaxed);
+	machine->cpu->ports[1] = controls & 0xff;
+	machine->cpu->ports[2] = controls >> 8;
+}
+
+// Takes the columns the beam just passed: drawn right away on the machine's
+// thread, or copied for the render thread. Stores behind the beam wait for
+// the next frame, like on the cabinet's monitor.
+static void window_scanlines(Machine* machine, int first, int end) {
+	Window* window = (Window*) machine->hooks.user;
+	if (window->pacer.skip || !video_dirty_move(&window->dirty, &window->shown, first, end)) {
+		return;
+	}
+
+	uint8_t const* vram = machine->cpu->memory + VRAM_START;
+	if (window->frames == NULL) {
+		SDL_Surface* surf = window->display->surf;
+		video_expand(vram, (uint32_t*) surf->pixels, surf->pitch / 4, &window->display->palette, first, end);
+	}
+	else {
+		memcpy(window->beam_vram + first * VRAM_COLUMN_BYTES, vram + first * VRAM_COLUMN_BYTES, (end - first) * VRAM_COLUMN_BYTES);
+	}
+}
+
+// Leaves frames the pacer skips undrawn. Their marks stay for the next frame.
+static void window_present(Machine* machine) {
+	Window* window = (Window*) machine->hooks.user;
+	if (!window->pacer.skip) {
+		if (window->beam && window->frames == NULL) {
+			show_video(window->display, &window->shown);
+		}
+		else if (window->beam) {
+			frame_exchange_publish(window->frames, window->beam_vram, &window->shown);
+		}
+		else if (window->frames == NULL) {
+			draw_video_ram(window->display, machine->cpu->memory + VRAM_START, &window->dirty);
+		}
+		else {
+			frame_exchange_publish(window->frames, machine->cpu->memory + VRAM_START, &window->dirty);
+		}
+	}
+
+	if (!pacer_wait(&window->pacer)) {
+		puts("Too slow!");
+	}
+}
+
+// Draws the frames the machine publishes until the window is closed
+static void render_loop(Window* window) {
+	uint8_t ports[9] = { 0,0,0,0,0,0,0,0,0 };
+	int64_t shown = -1;
+	VideoDirty dirty;
+
+	while (handle_input(ports)) {
+		window->controls.store(ports[1] | (ports[2] << 8), std::memory_order_relaxed);
+
+		VideoFrame const* frame = frame_exchange_take(window->frames);
+		if (frame == NULL) {
+			SDL_Delay(1);
+			continue;
+		}
+
+		// The marks of frames that were dropped are lost with them
+		dirty = frame->dirty;
+		if ((int64_t) frame->number != shown + 1) {
+			video_dirty_mark_all(&dirty);
+		}
+		shown = (int64_t) frame->number;
+		draw_video_ram(window->display, frame->vram, &dirty);
+	}
+	window->running = false;
+}
+#endif
+
+int main(int argc, char *argv[]) {
+
+	char const* engine = "switch";
+	bool lazy_flags = false;
+	int verify_frames = 0;
+	bool jit = false;
+	int verify_jit_frames = 0;
+	bool aot = false;
+	bool skip_idle = false;
+	char const* rom = "C:/Users/Hernandez/Desktop/8080ROM/invaders";
+	bool headless = false;
+	int frames = 0;
+	char const* input_path = NULL;
+	char const* vram_path = NULL;
+	char const* batch_path = NULL;
+	char const* trace_path = NULL;
+	char const* count_path = NULL;
+	int profile_period = 0;
+	bool coverage = false; // the run core marks coverage for the profile
+	int threads = 0;
+	bool flat_memory = false;
+	double speed = -1; // not given
+#ifndef I8080_HEADLESS
+	bool overlay = false;
+	bool render_thread = true;
+	bool beam = false;
+	int frameskip = 4;
+#endif
+
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--engine=", 9) == 0) {
+			engine = argv[i] + 9;
+		}
+		else if (strcmp(argv[i], "--lazy-flags") == 0) {
+			lazy_flags = true;
+		}
+		else if (strncmp(argv[i], "--verify-lazy-flags=", 20) == 0) {
+			verify_frames = atoi(argv[i] + 20);
+		}
+		else if (strcmp(argv[i], "--jit") == 0) {
+			jit = true;
+		}
+		else if (strncmp(argv[i], "--verify-jit=", 13) == 0) {
+			verify_jit_frames = atoi(argv[i] + 13);
+		}
+		else if (strcmp(argv[i], "--aot") == 0) {
+			aot = true;
+		}
+		else if (strcmp(argv[i], "--skip-idle") == 0) {
+			skip_idle = true;
+		}
+		else if (strncmp(argv[i], "--rom=", 6) == 0) {
+			rom = argv[i] + 6;
+		}
+		else if (strcmp(argv[i], "--headless") == 0) {
+			headless = true;
+		}
+		else if (strncmp(argv[i], "--frames=", 9) == 0) {
+			frames = atoi(argv[i] + 9);
+		}
+		else if (strncmp(argv[i], "--input=", 8) == 0) {
+			input_path = argv[i] + 8;
+		}
+		else if (strncmp(argv[i], "--dump-vram=", 12) == 0) {
+			vram_path = argv[i] + 12;
+		}
+		else if (strncmp(argv[i], "--batch=", 8) == 0) {
+			batch_path = argv[i] + 8;
+		}
+		else if (strncmp(argv[i], "--threads=", 10) == 0) {
+			threads = atoi(argv[i] + 10);
+		}
+		else if (strncmp(argv[i], "--trace=", 8) == 0) {
+			trace_path = argv[i] + 8;
+		}
+		else if (strncmp(argv[i], "--count-ops=", 12) == 0) {
+			count_path = argv[i] + 12;
+		}
+		else if (strncmp(argv[i], "--profile=", 10) == 0) {
+			profile_period = atoi(argv[i] + 10);
+		}
+		else if (strcmp(argv[i], "--flat-memory") == 0) {
+			flat_memory = true;
+		}
+		else if (strncmp(argv[i], "--speed=", 8) == 0) {
+			speed = atof(argv[i] + 8);
+			speed = speed > 0 ? speed : 0;
+		}
+#ifndef I8080_HEADLESS
+		// Window options, a build without SDL has no window
+		else if (strcmp(argv[i], "--overlay") == 0) {
+			overlay = true;
+		}
+		else if (strcmp(argv[i], "--single-thread") == 0) {
+			render_thread = false;
+		}
+		else if (strncmp(argv[i], "--frameskip=", 12) == 0) {
+			frameskip = atoi(argv[i] + 12);
+			frameskip = frameskip > 0 ? frameskip : 0;
+		}
+		else if (strcmp(argv[i], "--beam") == 0) {
+			beam = true;
+		}
+#endif
+	}
+
+#ifdef I8080_HEADLESS
+	// Built without SDL, there is no window to open
+	headless = true;
+#endif
+
+	if (strcmp(engine, "switch") != 0 && strcmp(engine, "threaded") != 0 && strcmp(engine, "blocks") != 0) {
+		printf("Unknown engine %s, using switch (engines: switch, threaded, blocks)\n", engine);
+		engine = "switch";
+	}
+	if (strcmp(engine, "threaded") == 0 && !threaded_available()) {
+		puts("Threaded engine not available in this build, using switch");
+		engine = "switch";
+	}
+
+	if ((jit || verify_jit_frames > 0) && !jit_available()) {
+		puts("JIT not available on this host, using the interpreter");
+		jit = false;
+		verify_jit_frames = 0;
+	}
+	if (jit && lazy_flags) {
+		puts("The JIT always uses eager flags, ignoring --lazy-flags");
+	}
+
+	if (skip_idle && !jit && strcmp(engine, "switch") != 0) {
+		puts("--skip-idle runs the switch interpreter, ignoring --engine");
+		engine = "switch";
+	}
+
+#ifdef I8080_TRACE
+	// Only the switch interpreter is built with PrintTrace
+	if (jit || aot || skip_idle || strcmp(engine, "switch") != 0) {
+		puts("I8080_TRACE only traces the switch interpreter, this run prints no trace");
+	}
+#endif
+
+	// Interpreter core, picked once at startup
+	int (*run)(CPU*, double);
+	if (strcmp(engine, "threaded") == 0) {
+		run = lazy_flags ? cpu_run_threaded<LazyFlags> : cpu_run_threaded<EagerFlags>;
+	}
+	else if (strcmp(engine, "blocks") == 0) {
+		run = lazy_flags ? cpu_run_blocks<LazyFlags> : cpu_run_blocks<EagerFlags>;
+	}
+	else {
+		run = lazy_flags ? cpu_run<DefaultTrace, LazyFlags> : cpu_run<DefaultTrace, EagerFlags>;
+	}
+	if (skip_idle) {
+		run = lazy_flags ? cpu_run_skip_idle<LazyFlags> : cpu_run_skip_idle<EagerFlags>;
+	}
+	if (jit) {
+		run = cpu_run_jit;
+	}
+	// Traces and counts follow one machine, and a core takes one policy
+	if (batch_path != NULL && (trace_path != NULL || count_path != NULL)) {
+		puts("--trace and --count-ops follow a single machine, ignoring them with --batch");
+		trace_path = NULL;
+		count_path = NULL;
+	}
+	if (trace_path != NULL && count_path != NULL) {
+		puts("--count-ops can't run with --trace, ignoring --count-ops");
+		count_path = NULL;
+	}
+	if (trace_path != NULL) {
+		// Only the switch interpreter takes a trace policy
+		if (jit || aot || skip_idle || strcmp(engine, "switch") != 0) {
+			puts("--trace runs the switch interpreter, ignoring the other engine options");
+		}
+		run = lazy_flags ? cpu_run<RingTrace, LazyFlags> : cpu_run<RingTrace, EagerFlags>;
+		engine = "switch";
+		jit = false;
+		aot = false;
+	}
+	else if (count_path != NULL) {
+		// The threaded core counts too, so the two can be compared
+		bool const threaded = strcmp(engine, "threaded") == 0;
+		if (jit || aot || skip_idle || (!threaded && strcmp(engine, "switch") != 0)) {
+			puts("--count-ops runs the switch or threaded interpreter, ignoring the other engine options");
+		}
+		if (threaded) {
+			run = lazy_flags ? cpu_run_threaded<LazyFlags, CountTrace> : cpu_run_threaded<EagerFlags, CountTrace>;
+		}
+		else {
+			run = lazy_flags ? cpu_run<CountTrace, LazyFlags> : cpu_run<CountTrace, EagerFlags>;
+			engine = "switch";
+		}
+		jit = false;
+		aot = false;
+	}
+	else if (profile_period > 0) {
+		// Coverage takes the trace policy, which only the interpreters have
+		bool const threaded = strcmp(engine, "threaded") == 0;
+		if (!jit && !aot && !skip_idle && (threaded || strcmp(engine, "switch") == 0)) {
+			if (threaded) {
+				run = lazy_flags ? cpu_run_threaded<LazyFlags, CoverTrace> : cpu_run_threaded<EagerFlags, CoverTrace>;
+			}
+			else {
+				run = lazy_flags ? cpu_run<CoverTrace, LazyFlags> : cpu_run<CoverTrace, EagerFlags>;
+			}
+			coverage = true;
+		}
+	}
+
+	Machine* machine = machine_init();
+	if (machine == NULL) {
+		return 1;
+	}
+	machine->run = run;
+	CPU* cpu = machine->cpu;
+	if (flat_memory) {
+		bus_map_flat(cpu);
+	}
+	if (jit) {
+		jit_init(cpu);
+	}
+	else if (strcmp(engine, "blocks") == 0) {
+		block_cache_init(cpu);
+	}
+
+	if (!machine_load(machine, rom)) {
+		machine_free(machine);
+		return 1;
+	}
+
+	if (aot) {
+		if (aot_init(cpu)) {
+			if (lazy_flags) {
+				puts("Compiled code always uses eager flags, ignoring --lazy-flags");
+			}
+			machine->run = cpu_run_aot;
+		}
+		else {
+			puts("No compiled code for this ROM in this build, using the interpreter");
+		}
+	}
+
+	if (batch_path != NULL) {
+		// Every job gets a fresh machine set up like this one
+		BatchEngine batch_engine;
+		batch_engine.run = machine->run;
+		batch_engine.init = NULL;
+		batch_engine.map = flat_memory ? bus_map_flat : NULL;
+		if (machine->run == cpu_run_aot) {
+			batch_engine.init = aot_setup;
+		}
+		else if (jit) {
+			batch_engine.init = jit_init;
+		}
+		else if (strcmp(engine, "blocks") == 0) {
+			batch_engine.init = block_cache_init;
+		}
+		machine_free(machine);
+
+		if (threads <= 0) {
+			threads = (int) std::thread::hardware_concurrency();
+			threads = threads > 0 ? threads : 1;
+		}
+
+		std::vector<BatchJob> jobs;
+		std::vector<uint8_t> image;
+		if (!batch_load(&jobs, batch_path) || !batch_read_rom(&image, rom)) {
+			return 1;
+		}
+
+		std::vector<BatchResult> results;
+		double seconds = batch_run(jobs, image, batch_engine, threads, &results);
+		return batch_report(jobs, results, seconds, threads) == 0 ? 0 : 1;
+	}
+
+	if (verify_frames > 0) {
+		long steps = verify_lazy_flags(cpu, verify_frames);
+		if (steps >= 0) {
+			printf("Lazy flags match eager flags for %ld instructions\n", steps);
+		}
+		machine_free(machine);
+		return steps >= 0 ? 0 : 1;
+	}
+
+	if (verify_jit_frames > 0) {
+		long steps = jit_verify(cpu, verify_jit_frames);
+		if (steps >= 0) {
+			printf("JIT matches the interpreter for %ld instructions\n", steps);
+		}
+		machine_free(machine);
+		return steps >= 0 ? 0 : 1;
+	}
+
+	InputScript script;
+	if (headless && input_path != NULL && !input_script_load(&script, input_path)) {
+		machine_free(machine);
+		return 1;
+	}
+	if (trace_path != NULL && !trace_open(cpu, trace_path)) {
+		machine_free(machine);
+		return 1;
+	}
+	OpCounts counts;
+	if (count_path != NULL) {
+		op_counts_clear(&counts);
+		cpu->counts = &counts;
+	}
+	if (profile_period > 0) {
+		Profile* profile = new Profile();
+		profile_init(profile, profile_period);
+		profile->coverage = coverage;
+		machine_start_profile(machine, profile, profile_period);
+	}
+
+	if (headless) {
+		Pacer pacer;
+		pacer_init(&pacer, speed < 0 ? 0 : speed, 0);
+		run_headless(machine, frames, input_path != NULL ? &script : NULL, speed >= 0 ? &pacer : NULL);
+
+		bool ok = vram_path == NULL || dump_vram(cpu, vram_path);
+		ok = dump_counts(cpu, count_path) && ok;
+		report_profile(machine);
+		trace_close(cpu);
+		machine_free(machine);
+		return ok ? 0 : 1;
+	}
+
+#ifndef I8080_HEADLESS
+	Window window;
+	window.display = display_init();
+	if (overlay) {
+		video_palette_overlay(&window.display->palette);
+	}
+	video_dirty_attach(cpu, &window.dirty);
+	pacer_init(&window.pacer, speed < 0 ? 1 : speed, frameskip);
+	window.frames = NULL;
+	window.controls = 0;
+	window.running = true;
+	machine->hooks.input = window_input;
+	machine->hooks.present = window_present;
+	machine->hooks.user = &window;
+
+	window.beam = beam;
+	video_dirty_clear(&window.shown);
+	memset(window.beam_vram, 0, sizeof(window.beam_vram));
+	if (beam) {
+		machine->hooks.scanlines = window_scanlines;
+		machine_start_beam(machine);
+	}
+
+	if (render_thread) {
+		FrameExchange* frames = new FrameExchange();
+		frame_exchange_init(frames);
+		window.frames = frames;
+
+		std::thread emulation([&] {
+			while (window.running) {
+				machine_run_frame(machine);
+			}
+		});
+		render_loop(&window);
+		emulation.join();
+		delete frames;
+	}
+	else {
+		while (window.running) {
+			machine_run_frame(machine);
+		}
+	}
+
+	pacer_report(&window.pacer);
+	display_free(window.display);
+#endif
+
+	dump_counts(cpu, count_path);
+	report_profile(machine);
+	trace_close(cpu);
+	machine_free(machine);
+
+	return 0;
+}
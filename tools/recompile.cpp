@@ -0,0 +1,340 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+#include "../src/CPU.h"
+#include "../src/Files.h"
+
+// Static recompiler: turns a ROM image into a C++ file for cpu_run_aot (see
+// src/Aot.h). Built together with the emulator sources minus main.cpp, e.g.
+//   g++ -O2 tools/recompile.cpp src/CPU.cpp src/Disassembler.cpp src/BlockCache.cpp src/Jit.cpp src/Verify.cpp src/Memory.cpp src/Bus.cpp src/Ports.cpp src/Trace.cpp -pthread
+//   ./a.out invaders invaders_aot.cpp
+// and then the emulator is built with invaders_aot.cpp and -DI8080_AOT.
+//
+// The generated code does what EmulateI8080_op<NoTrace, EagerFlags> does,
+// quirks included, by calling the same helpers.
+
+int const MAX_BLOCK_OPS = 64; // 64 instructions always fit in two pages
+
+// What the interpreter does with each opcode, as far as the walk cares
+enum OpKind {
+	OP_UNKNOWN, // unimplemented, the walk stops
+	OP_PLAIN, // translated, falls through
+	OP_STORE, // translated, falls through, writes memory
+	OP_JUMP, // JMP
+	OP_JUMP_COND, // Jcc, target and fall through
+	OP_CALL, // CALL, target and the return address
+	OP_RET, // RET, nothing the walk can follow
+	OP_RET_COND, // Rcc, falls through
+	OP_IO, // IN and OUT, always left to the interpreter
+};
+
+static OpKind op_kind(uint8_t const op) {
+	switch (op)
+	{
+	case 0x00: case 0x01: case 0x05: case 0x06: case 0x09: case 0x0d: case 0x0e: case 0x0f:
+	case 0x11: case 0x13: case 0x19: case 0x1a: case 0x1e:
+	case 0x21: case 0x23: case 0x26: case 0x27: case 0x29:
+	case 0x31: case 0x35: case 0x3a: case 0x3d: case 0x3e:
+	case 0x56: case 0x5e: case 0x66: case 0x6f:
+	case 0x7a: case 0x7b: case 0x7c: case 0x7d: case 0x7e:
+	case 0xa7: case 0xaf:
+	case 0xc1: case 0xc6: case 0xd1: case 0xe1: case 0xe6: case 0xeb:
+	case 0xf1: case 0xfb: case 0xfe:
+		return OP_PLAIN;
+	case 0x32: case 0x36: case 0x77: case 0xc5: case 0xd5: case 0xe5: case 0xf5:
+		return OP_STORE;
+	case 0xc3:
+		return OP_JUMP;
+	case 0xc2: case 0xca: case 0xd2: case 0xda:
+		return OP_JUMP_COND;
+	case 0xcd:
+		return OP_CALL;
+	case 0xc9:
+		return OP_RET;
+	case 0xc0: case 0xc8:
+		return OP_RET_COND;
+	case 0xd3: case 0xdb:
+		return OP_IO;
+	}
+
+	return OP_UNKNOWN;
+}
+
+// How far the interpreter moves pc past a translated instruction. 0x1e has no
+// case in EmulateI8080_op, so it runs as a one byte NOP.
+static int op_length(uint8_t const op) {
+	return op == 0x1e ? 1 : lengths8080[op];
+}
+
+/*
+	EFFECTS : returns the C++ for the translated instruction op with operand
+			  bytes lo and hi at address. Jumps, calls and returns set pc;
+			  everything else leaves it to the end of the block.
+*/
+
+static std::string statement(uint8_t const op, uint8_t const lo, uint8_t const hi, int const address) {
+	char buf[160];
+	unsigned const word = (hi << 8) | lo;
+	unsigned const next = address + 1; // pc as the interpreter has it while running op
+
+	switch (op)
+	{
+	case 0x00: return "NOP(cpu); // NOP";
+	case 0x01: snprintf(buf, sizeof(buf), "cpu->c = 0x%02x; cpu->b = 0x%02x; // LXI B,D16", lo, hi); break;
+	case 0x05: return "DCR<EagerFlags>(cpu, cpu->b); // DCR B";
+	case 0x06: snprintf(buf, sizeof(buf), "MOV(cpu->b, 0x%02x); // MVI B, D8", lo); break;
+	case 0x09: return "DAD(cpu, CPU_get_bc(cpu)); // DAD B";
+	case 0x0d: return "DCR<EagerFlags>(cpu, cpu->c); // DCR C";
+	case 0x0e: snprintf(buf, sizeof(buf), "MOV(cpu->c, 0x%02x); // MVI C, D8", lo); break;
+	case 0x0f: return "RRC(cpu); // RRC";
+	case 0x11: snprintf(buf, sizeof(buf), "cpu->e = 0x%02x; cpu->d = 0x%02x; // LXI D, word", lo, hi); break;
+	case 0x13: return "CPU_set_de(cpu, CPU_get_de(cpu) + 1); // INX D";
+	case 0x19: return "DAD(cpu, CPU_get_de(cpu)); // DAD D";
+	case 0x1a: return "MOV(cpu->a, CPU_read(cpu, CPU_get_de(cpu))); // LDAX D";
+	case 0x1e: return "// 0x1e, a NOP in EmulateI8080_op";
+	case 0x21: snprintf(buf, sizeof(buf), "cpu->l = 0x%02x; cpu->h = 0x%02x; // LXI H, D16", lo, hi); break;
+	case 0x23: return "CPU_set_hl(cpu, CPU_get_hl(cpu) + 1); // INX H";
+	case 0x26: snprintf(buf, sizeof(buf), "MOV(cpu->h, 0x%02x); // MVI H, D8", lo); break;
+	case 0x27: return "DAA<EagerFlags>(cpu); // DAA";
+	case 0x29: return "DAD(cpu, CPU_get_hl(cpu)); // DAD H";
+	case 0x31: snprintf(buf, sizeof(buf), "cpu->sp = 0x%04x; // LXI SP,word", word); break;
+	case 0x32: snprintf(buf, sizeof(buf), "CPU_write(cpu, 0x%04x, cpu->a); // STA adr", word); break;
+	case 0x35: return "CPU_set_hl(cpu, CPU_get_hl(cpu) - 1); // DCR M";
+	case 0x36: snprintf(buf, sizeof(buf), "CPU_write(cpu, CPU_get_hl(cpu), 0x%02x); // MVI M, D8", lo); break;
+	case 0x3a: snprintf(buf, sizeof(buf), "MOV(cpu->a, CPU_read(cpu, 0x%04x)); // LDA adr", word); break;
+	case 0x3d: return "DCR<EagerFlags>(cpu, cpu->a); // DCR A";
+	case 0x3e: snprintf(buf, sizeof(buf), "MOV(cpu->a, 0x%02x); // MVI A, D8", lo); break;
+	case 0x56: return "MOV(cpu->d, CPU_read(cpu, CPU_get_hl(cpu))); // MOV D, M";
+	case 0x5e: return "MOV(cpu->e, CPU_read(cpu, CPU_get_hl(cpu))); // MOV E, M";
+	case 0x66: return "MOV(cpu->h, CPU_read(cpu, CPU_get_hl(cpu))); // MOV H, M";
+	case 0x6f: return "MOV(cpu->l, cpu->a); // MOV L, A";
+	case 0x77: return "CPU_write(cpu, CPU_get_hl(cpu), cpu->a); // MOV M, A";
+	case 0x7a: return "MOV(cpu->a, cpu->d); // MOV A, D";
+	case 0x7b: return "MOV(cpu->a, cpu->e); // MOV A, E";
+	case 0x7c: return "MOV(cpu->a, cpu->h); // MOV A, H";
+	case 0x7d: return "MOV(cpu->a, cpu->l); // MOV A, L";
+	case 0x7e: return "MOV(cpu->a, CPU_read(cpu, CPU_get_hl(cpu))); // MOV A, M";
+	case 0xa7: return "ANA<EagerFlags>(cpu, cpu->a); // ANA A";
+	case 0xaf: return "XRA<EagerFlags>(cpu, cpu->a); // XRA A";
+	case 0xc0: snprintf(buf, sizeof(buf), "cpu->pc = 0x%04x; bool const taken = RET_COND(cpu, cpu->cc.z != 0); // RNZ", next); break;
+	case 0xc1: return "POP(cpu, \"B\"); // POP B";
+	case 0xc2: snprintf(buf, sizeof(buf), "cpu->pc = 0x%04x; JMP_COND(cpu, 0x%04x, 0 == cpu->cc.z); // JNZ adr", next, word); break;
+	case 0xc3: snprintf(buf, sizeof(buf), "JMP(cpu, 0x%04x); // JMP adr", word); break;
+	case 0xc5: return "PUSH(cpu, \"B\"); // PUSH B";
+	case 0xc6: snprintf(buf, sizeof(buf), "ADD<EagerFlags>(cpu, cpu->a, 0x%02x, 0); // ADI D8", lo); break;
+	case 0xc8: snprintf(buf, sizeof(buf), "cpu->pc = 0x%04x; bool const taken = RET_COND(cpu, cpu->cc.z); // RZ", next); break;
+	case 0xc9: return "RET(cpu); // RET";
+	case 0xca: snprintf(buf, sizeof(buf), "cpu->pc = 0x%04x; JMP_COND(cpu, 0x%04x, cpu->cc.z != 0); // JZ adr", next, word); break;
+	case 0xcd: snprintf(buf, sizeof(buf), "cpu->pc = 0x%04x; CALL(cpu, 0x%04x); // CALL adr", next, word); break;
+	case 0xd1: return "POP(cpu, \"D\"); // POP D";
+	case 0xd2: snprintf(buf, sizeof(buf), "cpu->pc = 0x%04x; JMP_COND(cpu, 0x%04x, cpu->cc.cy == 0); // JNC adr", next, word); break;
+	case 0xd5: return "PUSH(cpu, \"D\"); // PUSH D";
+	case 0xda: snprintf(buf, sizeof(buf), "cpu->pc = 0x%04x; JMP_COND(cpu, 0x%04x, cpu->cc.cy != 0); // JC adr", next, word); break;
+	case 0xe1: return "POP(cpu, \"H\"); // POP H";
+	case 0xe5: return "PUSH(cpu, \"H\"); // PUSH H";
+	case 0xe6: snprintf(buf, sizeof(buf), "ANA<EagerFlags>(cpu, 0x%02x); // ANI D8", lo); break;
+	case 0xeb: return "{ uint8_t d = cpu->d; uint8_t e = cpu->e; cpu->d = cpu->h; cpu->e = cpu->l; cpu->h = d; cpu->l = e; } // XCHG";
+	case 0xf1: return "POP(cpu, \"PSW\"); // POP PSW";
+	case 0xf5: return "PUSH(cpu, \"PSW\"); // PUSH PSW";
+	case 0xfb: return "EI(cpu); // EI";
+	case 0xfe: snprintf(buf, sizeof(buf), "CMP<EagerFlags>(cpu, 0x%02x); // CPI D8", lo); break;
+	default: buf[0] = '\0'; break;
+	}
+
+	return buf;
+}
+
+struct Rom {
+	std::vector<uint8_t> bytes;
+	std::set<int> leaders; // addresses that start a block
+	std::vector<bool> reached;
+};
+
+// Whether the instruction at address can be translated
+static bool translatable(Rom const& rom, int const address) {
+	if (address >= (int) rom.bytes.size()) {
+		return false;
+	}
+
+	uint8_t const op = rom.bytes[address];
+	OpKind const kind = op_kind(op);
+	return kind != OP_UNKNOWN && kind != OP_IO && address + op_length(op) <= (int) rom.bytes.size();
+}
+
+/*
+	Modifies: rom.leaders, rom.reached
+	EFFECTS : Recursive descent from the vectors, following every jump,
+			  call and fall through the way the interpreter would take it.
+			  Returns are left to the run time lookup.
+*/
+
+static void walk(Rom& rom) {
+	std::vector<int> todo = { 0x0000, 0x0008, 0x0010 };
+	for (int address : todo) {
+		rom.leaders.insert(address);
+	}
+
+	while (!todo.empty()) {
+		int address = todo.back();
+		todo.pop_back();
+
+		while (address < (int) rom.bytes.size() && !rom.reached[address]) {
+			rom.reached[address] = true;
+			uint8_t const op = rom.bytes[address];
+			int const length = op_length(op);
+			int const target = address + 2 < (int) rom.bytes.size() ?
+				(rom.bytes[address + 2] << 8) | rom.bytes[address + 1] : 0;
+
+			OpKind const kind = op_kind(op);
+			if (kind == OP_UNKNOWN || kind == OP_RET) {
+				break;
+			}
+			if (kind == OP_JUMP) {
+				rom.leaders.insert(target);
+				todo.push_back(target);
+				break;
+			}
+			if (kind == OP_JUMP_COND || kind == OP_CALL) {
+				rom.leaders.insert(target);
+				todo.push_back(target);
+				rom.leaders.insert(address + length);
+			}
+			if (kind == OP_RET_COND) {
+				rom.leaders.insert(address + length);
+			}
+			if (kind == OP_IO) {
+				// Run by the interpreter, the next block starts after it
+				rom.leaders.insert(address + length);
+			}
+			address += length;
+		}
+	}
+}
+
+/*
+	EFFECTS : writes the block starting at start to out, returns false if
+			  the instruction there can't be translated
+*/
+
+static bool write_block(FILE* out, Rom const& rom, int const start, std::vector<std::string>& table) {
+	if (!translatable(rom, start)) {
+		return false;
+	}
+
+	std::vector<std::string> body;
+	int address = start;
+	int cycles = 0;
+	int lead_cycles = 0;
+	int ops = 0;
+	bool ended = false;
+	bool ret_cond = false; // the block ends in a conditional return, which sets taken
+	int const first_page = start >> 8;
+	int last_page = first_page;
+
+	while (ops < MAX_BLOCK_OPS && translatable(rom, address) && (address == start || rom.leaders.count(address) == 0)) {
+		uint8_t const op = rom.bytes[address];
+		int const length = op_length(op);
+		uint8_t const lo = length > 1 ? rom.bytes[address + 1] : 0;
+		uint8_t const hi = length > 2 ? rom.bytes[address + 2] : 0;
+		OpKind const kind = op_kind(op);
+
+		lead_cycles = cycles;
+		cycles += cycles8080[op];
+		ops++;
+		last_page = (address + length - 1) >> 8;
+		body.push_back(statement(op, lo, hi, address));
+		address += length;
+
+		if (kind == OP_JUMP || kind == OP_JUMP_COND || kind == OP_CALL || kind == OP_RET || kind == OP_RET_COND) {
+			ended = true;
+			ret_cond = kind == OP_RET_COND;
+			break;
+		}
+
+		// A store may hit this block's own code, which then has to stop
+		if (kind == OP_STORE) {
+			char check[160];
+			snprintf(check, sizeof(check), "if (!aot_live(cpu, 0x%02x) || !aot_live(cpu, 0x%02x)) { cpu->pc = 0x%04x; return %d; }",
+				first_page, last_page, address, cycles);
+			body.push_back(check);
+		}
+	}
+
+	fprintf(out, "static int block_%04x(CPU* const cpu) {\n", start);
+	for (std::string const& line : body) {
+		fprintf(out, "\t%s\n", line.c_str());
+	}
+	if (!ended) {
+		fprintf(out, "\tcpu->pc = 0x%04x;\n", address);
+	}
+	if (ret_cond) {
+		fprintf(out, "\treturn taken ? %d : %d;\n}\n\n", cycles, lead_cycles + CYCLES_RET_SKIPPED);
+	}
+	else {
+		fprintf(out, "\treturn %d;\n}\n\n", cycles);
+	}
+
+	char entry[96];
+	snprintf(entry, sizeof(entry), "\t{ 0x%04x, 0x%02x, 0x%02x, %d, block_%04x },", start, first_page, last_page, lead_cycles, start);
+	table.push_back(entry);
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 3) {
+		printf("usage: %s rom output.cpp\n", argv[0]);
+		return 1;
+	}
+
+	FILE* f = file_open(argv[1], "rb");
+	if (f == NULL) {
+		printf("error: Couldn't open %s\n", argv[1]);
+		return 1;
+	}
+
+	Rom rom;
+	int c;
+	while ((c = fgetc(f)) != EOF && rom.bytes.size() < 0x10000) {
+		rom.bytes.push_back((uint8_t) c);
+	}
+	fclose(f);
+	rom.reached.assign(rom.bytes.size(), false);
+
+	walk(rom);
+
+	FILE* out = file_open(argv[2], "w");
+	if (out == NULL) {
+		printf("error: Couldn't open %s\n", argv[2]);
+		return 1;
+	}
+
+	fprintf(out, "// Generated by tools/recompile.cpp from %s, do not edit.\n", argv[1]);
+	fprintf(out, "// Build with I8080_AOT defined, see src/Aot.h.\n\n");
+	fprintf(out, "#include \"Aot.h\"\n#include \"Flags.h\"\n\n");
+
+	std::vector<std::string> table;
+	for (int start : rom.leaders) {
+		if (start < (int) rom.bytes.size()) {
+			write_block(out, rom, start, table);
+		}
+	}
+
+	fprintf(out, "AotBlock const aot_blocks[] = {\n");
+	for (std::string const& entry : table) {
+		fprintf(out, "%s\n", entry.c_str());
+	}
+	fprintf(out, "};\n\nint const aot_block_count = %d;\n\n", (int) table.size());
+
+	fprintf(out, "uint8_t const aot_rom[] = {");
+	for (size_t i = 0; i < rom.bytes.size(); i++) {
+		fprintf(out, "%s0x%02x,", i % 16 == 0 ? "\n\t" : " ", rom.bytes[i]);
+	}
+	fprintf(out, "\n};\n\nint const aot_rom_size = %d;\n", (int) rom.bytes.size());
+	fclose(out);
+
+	printf("%d blocks from %d bytes\n", (int) table.size(), (int) rom.bytes.size());
+	return 0;
+}
@@ -0,0 +1,30 @@
+#include <cstdio>
+#include "../src/Trace.h"
+
+// Prints a binary trace written by --trace (see src/Trace.h) in the text
+// PrintTrace writes: the cycle stamp, the disassembled instruction and the
+// registers and flags after it. Only the cycle stamps differ: they count
+// from the start of the run instead of each cpu_run. Built with the
+// emulator sources minus main.cpp, e.g.
+//   g++ -O2 tools/tracedump.cpp src/Trace.cpp src/CPU.cpp src/Disassembler.cpp src/BlockCache.cpp src/Jit.cpp src/Verify.cpp src/Memory.cpp src/Bus.cpp src/Ports.cpp -pthread -o tracedump
+//   ./tracedump session.trace > session.txt
+
+int main(int argc, char* argv[]) {
+	if (argc != 2) {
+		printf("usage: %s trace-file\n", argv[0]);
+		return 1;
+	}
+
+	TraceReader reader;
+	if (!trace_reader_open(&reader, argv[1])) {
+		return 1;
+	}
+
+	TraceRecord record;
+	while (trace_reader_next(&reader, &record)) {
+		trace_print(&record);
+	}
+	trace_reader_close(&reader);
+
+	return 0;
+}